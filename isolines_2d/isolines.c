@@ -5,9 +5,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <limits.h>
 #include <time.h>
 #include <math.h>
 
+#include "system.h"
+#include "clock.h"
+#include "pool.h"
 #include "isolines.h"
 
 /*** SAMPLES *************************************************************************************/
@@ -68,42 +72,55 @@
 /* GRID_SAMPLE_ROW_COUNT * GRID_SAMPLE_COL_COUNT */
 #define SAMPLE_COUNT 10000 
 
-/* the maximum number of vertex components in the grid mesh; the size is twice the max number
- * of vertices; two components per vertex (2D). Should be precomputed value of:
- *      (SAMPLE_GRID_ROW_COUNT - 1) * (SAMPLE_GRID_COL_COUNT - 1) * 4 * 2 
- * why?
- *  SAMPLE_GRID_ROW/COL_COUNT = number of cell rows/columns 
- *  4 = max vertices per cell    
- *  2 = max components per vertex    
- *
- * However such a mesh will be significantly too large; a grid of 200x200 cells would have a limit
- * of:
- *      199 * 199 * 4 * 2 = 316808 floats
- *
- * This would only occur if every sample was alternately actived, which will never occur with
- * globbers. Thus set the size to a guesstimate and use trial and error to find a good value for
- * a given mesh size and glob count. Under normal conditions the generated meshes will be 
- * considerably smaller than the max. If the mesh is too small the program will abort and tell
- * you. */
-#define ISOLINES_MESH_MAX_SIZE 13000
-
 #define ISOLINES_MESH_COLOR_R 1.f
 #define ISOLINES_MESH_COLOR_G 0.f
 #define ISOLINES_MESH_COLOR_B 0.4f
 
 #define ISOLINES_MESH_DRAW_WIDTH_PX 3
 
+/* the number of threads used to extract the isolines mesh (including the main thread); 1 runs the
+ * serial extraction */
+#define ISOLINES_THREAD_COUNT 4
+
+/* when set the isolines mesh is built in a linked list of fixed size slabs (see the SLABS section)
+ * in a single pass, rather than in a contiguous buffer sized exactly by counting */
+#define ISOLINES_USE_MESH_SLABS 0
+
+/* when set (and slabs are used) the slabs are compacted into one contiguous buffer for drawing,
+ * rather than drawn slab by slab */
+#define ISOLINES_COMPACT_MESH_SLABS 0
+
+/* the number of strips of columns the grid is split into for parallel extraction; every strip of
+ * every threshold is a separate job. More strips than threads balances the load better, since
+ * the isolines are rarely spread evenly over the grid. */
+#define ISOLINES_STRIP_COUNT 8
+#define ISOLINES_JOB_COUNT (THRESHOLD_COUNT * ISOLINES_STRIP_COUNT)
+
+/* the maximum number of stitch vertices generated for a single threshold; one per cell edge, i.e:
+ *      (SAMPLE_GRID_COL_COUNT * (SAMPLE_GRID_ROW_COUNT - 1)) +      (vertical edges)
+ *      ((SAMPLE_GRID_COL_COUNT - 1) * SAMPLE_GRID_ROW_COUNT)        (horizontal edges)
+ * this can never be exceeded. */
+#define STITCH_VERTEX_MAX_COUNT ((SAMPLE_GRID_COL_COUNT * (SAMPLE_GRID_ROW_COUNT - 1)) + \
+                                 ((SAMPLE_GRID_COL_COUNT - 1) * SAMPLE_GRID_ROW_COUNT))
+
 /* dimensions of the grid in meters */
 static const float sample_grid_width_m = (SAMPLE_GRID_ROW_COUNT - 1) * CELL_SIZE_M;
 static const float sample_grid_height_m = (SAMPLE_GRID_COL_COUNT - 1) * CELL_SIZE_M;
 
-/* the number of threshold levels (or isovalues) for which to generate and render isolines. The
- * greater this number the more memory will be required for the isolines mesh, thus make sure
- * to increase that too (set with ISOLINES_MESH_MAX_SIZE) */
-#define THRESHOLD_COUNT 5
+/* the side lengths of the tiles and blocks of the min/max pyramid (unit: cells); tiles form the
+ * first level of the pyramid and blocks the second, thus the block size must be a multiple of the
+ * tile size */
+#define PYRAMID_TILE_SIZE 8
+#define PYRAMID_BLOCK_SIZE 64
+
+/* the number of tiles and blocks needed to cover all cells of the grid (rounded up) */
+#define PYRAMID_TILE_COL_COUNT (((SAMPLE_GRID_COL_COUNT - 1) + PYRAMID_TILE_SIZE - 1) / PYRAMID_TILE_SIZE)
+#define PYRAMID_TILE_ROW_COUNT (((SAMPLE_GRID_ROW_COUNT - 1) + PYRAMID_TILE_SIZE - 1) / PYRAMID_TILE_SIZE)
+#define PYRAMID_BLOCK_COL_COUNT (((SAMPLE_GRID_COL_COUNT - 1) + PYRAMID_BLOCK_SIZE - 1) / PYRAMID_BLOCK_SIZE)
+#define PYRAMID_BLOCK_ROW_COUNT (((SAMPLE_GRID_ROW_COUNT - 1) + PYRAMID_BLOCK_SIZE - 1) / PYRAMID_BLOCK_SIZE)
 
-/* the threshold (isovalues) to generate contour lines for */
-static const float thresholds[THRESHOLD_COUNT] = {0.6f, 0.8f, 1.f, 1.3f, 2.f};
+/* the number of threshold levels (or isovalues) for which to generate and render isolines */
+#define THRESHOLD_COUNT 5
 
 /*** SAMPLES *************************************************************************************/
 
@@ -118,22 +135,6 @@ struct sample_t
   float weight;
 };
 
-/* opengl 2.1 gfx data 
- *
- * each sample has a set of two vertex components (x and y) and a set of three color components
- * (r, g, b).
- *
- * vertices and colors are stored as a flattened 2d array so each sample can access it's data
- * as:
- *    sample_data[(col * (col_size * components_per_sample)) + 
- *                                         (row * components_per_sample) + component_id]
- * where:
- *    components_per_sample = 2 (for vertices), and = 3 (for colors)
- *    component_id = 0(->x) or 1(->y) (for vertices), and = 0(->r) or 1(->g) or 2(->b) (for colors).
- */
-static GLfloat sample_vertices[SAMPLE_COUNT * 2];
-static GLfloat sample_colors[SAMPLE_COUNT * 3];
-
 /*** CELLS ***************************************************************************************/
 
 #define SET_CORNER(corner_mask, state_mask) (state_mask |= corner_mask)
@@ -228,6 +229,12 @@ struct cell_t
    */
   int8_t indices[4];
 
+  /* index of the stitch vertex generated at each point (see 'generate_isolines_polylines'); the
+   * elements map to points as for the 'points' array. Only the elements referenced by 'indices'
+   * are valid. Like the points, a cell reuses the vertices of the left and right points of the
+   * cells to its left and below it; this is what links the segments of adjacent cells together. */
+  int vertex_ids[4];
+
   /* mask of which corners of the cell are active, illustrated below:
    *
    * where:
@@ -251,6 +258,20 @@ struct cell_t
   uint8_t state_mask; 
 };
 
+/* the state mask of a cell from the weights of its corners, in the order of the bits of the mask
+ * (see 'struct cell_t') */
+static inline uint8_t
+get_cell_state_mask(const float weights[4], float threshold)
+{
+  uint8_t state_mask = 0;
+
+  for(int i = CELL_WEIGHT_BL; i <= CELL_WEIGHT_TL; i++)
+    if(weights[i] >= threshold)
+      SET_CORNER((0b0001 << i), state_mask);
+
+  return state_mask;
+}
+
 /* compute the geometry of the cell based on the 4 sample values and the threshold; the threshold 
  * is the boundary between weights considered 'active' and 'inactive'. Samples are expected in
  * the order:
@@ -258,7 +279,7 @@ struct cell_t
 static void
 compute_cell(struct sample_t samples[4], float threshold, struct cell_t *cell)
 {
-  static struct point2d_t default_points[4] = {
+  static const struct point2d_t default_points[4] = {
     {0.f               , CELL_SIZE_M * 0.5f},
     {CELL_SIZE_M * 0.5f, 0.f               },
     {CELL_SIZE_M       , CELL_SIZE_M * 0.5f},
@@ -280,11 +301,13 @@ compute_cell(struct sample_t samples[4], float threshold, struct cell_t *cell)
   memcpy((void *)&cell->indices[0], (void *)&cell_lookup[cell->state_mask][0], sizeof(uint8_t) * 4);
 }
 
-/* used in function 'lerp_cell' */
+/* the offset of the crossing of the threshold along an edge of a cell of 'cell_size_m', from the
+ * minor sample of the edge; used in function 'lerp_cell' and by the batch and stream 
+ * extractions */
 static float
-lerp(float threshold, float minor_weight, float major_weight)
+lerp(float threshold, float minor_weight, float major_weight, float cell_size_m)
 {
-  return CELL_SIZE_M * ((threshold - minor_weight) / (major_weight - minor_weight));
+  return cell_size_m * ((threshold - minor_weight) / (major_weight - minor_weight));
 }
 
 /* linearly interpolate the points of a computed cell; cell must be created with function
@@ -351,7 +374,7 @@ lerp_cell(float threshold, struct cell_t *cell, struct cell_t *bottom, struct ce
       {
         cell->points[index].y = lerp(threshold, 
                                      cell->samples[CELL_WEIGHT_BL].weight, 
-                                     cell->samples[CELL_WEIGHT_TL].weight);
+                                     cell->samples[CELL_WEIGHT_TL].weight, CELL_SIZE_M);
       }
       break;
     case CELL_POINT_B:
@@ -365,18 +388,18 @@ lerp_cell(float threshold, struct cell_t *cell, struct cell_t *bottom, struct ce
       {
         cell->points[index].x = lerp(threshold, 
                                      cell->samples[CELL_WEIGHT_BL].weight, 
-                                     cell->samples[CELL_WEIGHT_BR].weight);
+                                     cell->samples[CELL_WEIGHT_BR].weight, CELL_SIZE_M);
       }
       break;
     case CELL_POINT_R:
       cell->points[index].y = lerp(threshold, 
                                    cell->samples[CELL_WEIGHT_BR].weight, 
-                                   cell->samples[CELL_WEIGHT_TR].weight);
+                                   cell->samples[CELL_WEIGHT_TR].weight, CELL_SIZE_M);
       break;
     case CELL_POINT_T:
       cell->points[index].x = lerp(threshold, 
                               cell->samples[CELL_WEIGHT_TL].weight, 
-                              cell->samples[CELL_WEIGHT_TR].weight);
+                              cell->samples[CELL_WEIGHT_TR].weight, CELL_SIZE_M);
       break;
     }
   }
@@ -396,12 +419,6 @@ struct globber_t
   struct vector2d_t dir;
 };
 
-/* the glob mesh drawn by opengl */
-static GLfloat glob_vertices[GLOB_MESH_RESOLUTION * 2];
-
-/* the globbers that move around the grid, shaping the isolines */
-static struct globber_t globbers[GLOB_COUNT];
-
 /*** GRID ****************************************************************************************/
 
 /* A grid of sample points. The square area between every set of 4 adjacent samples is a cell. The 
@@ -435,30 +452,1026 @@ struct sample_grid_t
   struct sample_t samples[SAMPLE_GRID_COL_COUNT][SAMPLE_GRID_ROW_COUNT];
 };
 
-/* the simulation grid */
-static struct sample_grid_t grid;
+/* what a mesh chunk does when it is full */
+enum mesh_chunk_growth_t
+{
+  MESH_CHUNK_FIXED,   /* nothing; the chunk was sized exactly for its components so is never full */
+  MESH_CHUNK_REALLOC, /* the chunk owns its components and reallocates them to grow */
+  MESH_CHUNK_SLABS    /* the chunk is the open tail slab of a slab mesh; a new slab is linked */
+};
+
+/* a buffer of isolines mesh vertex components that the extraction writes to */
+struct mesh_chunk_t
+{
+  GLfloat *components;
+  int component_count;
+  int capacity;
+  enum mesh_chunk_growth_t growth;
+
+  /* the slab mesh the chunk appends to; only used by MESH_CHUNK_SLABS chunks */
+  struct slab_mesh_t *slab_mesh;
+
+  /* the metrics sums the segments written to the chunk are added to; NULL if none */
+  struct level_metrics_sums_t *metrics;
+};
+
+/* a linked list of slabs holding a mesh (see the SLABS section) */
+struct slab_mesh_t
+{
+  struct isolines_mesh_slab_t *head;
+  struct isolines_mesh_slab_t *tail;
+
+  /* the total component count of all closed slabs of the mesh */
+  int component_count;
+};
+
+/* running sums of the metrics of the isolines of a level (see 'struct isolines_level_metrics_t'),
+ * accumulated segment by segment during extraction. The area and centroid are integrated over the
+ * boundary of the region at or above the threshold (Green's theorem, i.e. the shoelace formula);
+ * the boundary is the isolines, oriented with the region on their left, plus the parts of the 
+ * border of the grid inside the region. Sums are in double precision since a level can have 
+ * many thousands of segments. */
+struct level_metrics_sums_t
+{
+  double length;
+  double area2;             /* twice the area */
+  double centroid6_x;       /* six times the area times the centroid */
+  double centroid6_y;
+  struct point2d_t min, max;
+};
+
+/*** SLABS ***************************************************************************************/
+
+/* slabs are only ever filled with whole segments; a segment is 4 components */
+_Static_assert(ISOLINES_MESH_SLAB_SIZE % 4 == 0, "slabs must hold a whole number of segments");
+
+/*** PYRAMID *************************************************************************************/
+
+/* the range of the weights of all samples within a region of the grid */
+struct weight_range_t
+{
+  float min;
+  float max;
+};
+
+/* a tile (by id, tile_col * PYRAMID_TILE_ROW_COUNT + tile_row) and the key it is sorted by. The
+ * tiles are sorted as pairs, by key, since the keys are per context and a qsort comparator has no
+ * argument to find them through. */
+struct tile_sort_entry_t
+{
+  float key;
+  int tile;
+};
+
+/*** SPAN SPACE **********************************************************************************/
+
+/* the number of tiles indexed by the span space index; one per pyramid tile */
+#define SPAN_TILE_COUNT (PYRAMID_TILE_COL_COUNT * PYRAMID_TILE_ROW_COUNT)
+
+#define SPAN_NODE_NULL -1
+
+/* a node of the span space index. The index is an interval tree over the weight ranges of the
+ * pyramid tiles; each node stores the tiles whose range contains the node's center weight, the
+ * left subtree the tiles entirely below the center and the right subtree the tiles entirely above
+ * it:
+ *
+ *    weight
+ *      ^           |            tiles containing the center -> this node
+ *      |   [---]   |  [--]      tiles below the center      -> left subtree
+ *      | [-------------]        tiles above the center      -> right subtree
+ *      |       [---|-----]
+ *      +-----------+----------> 
+ *               center
+ *
+ * tiles are identified by their index into the (flattened) pyramid tile array, i.e.
+ *    tile_col * PYRAMID_TILE_ROW_COUNT + tile_row
+ */
+struct span_node_t
+{
+  float center;
+
+  /* the tiles containing the center are stored in the range [first, first + count) of both the
+   * span_tiles_by_min array (in ascending order of range min) and the span_tiles_by_max array
+   * (in descending order of range max) */
+  int first;
+  int count;
+
+  /* subtrees, or SPAN_NODE_NULL */
+  int left;
+  int right;
+};
+
+/*** REMESHING ***********************************************************************************/
+
+/* the largest change in the weight of a sample since its tile was last extracted that is ignored
+ * by incremental remeshing. Larger changes mark the tile dirty (for re-extraction). Changes which
+ * move a sample across a threshold always mark the tile dirty, however small, so the topology of
+ * the mesh is always current; only the positions of the points of clean tiles lag, by the lerp 
+ * of at most this much weight. Zero makes the incremental mesh exact. */
+#define ISOLINES_REMESH_EPSILON 0.01f
+
+#define REMESH_TILE_COUNT (PYRAMID_TILE_COL_COUNT * PYRAMID_TILE_ROW_COUNT)
+
+/* the work budget of the incremental remeshing of a single tick. Once either budget is spent the
+ * remaining dirty tiles are left until the next tick (where they are still dirty, since the 
+ * samples they were extracted from are unchanged) and keep their last complete mesh until then;
+ * a spike in the number of dirty tiles thus spreads over several ticks as progressive refinement
+ * rather than a long tick. The time budget is checked between batches of tiles (one tile per 
+ * thread) so may be overrun by up to a batch. Zero disables a budget. */
+#define ISOLINES_REMESH_BUDGET_S 0.004
+#define ISOLINES_REMESH_BUDGET_TILES 0
+
+/*** STITCHING ***********************************************************************************/
+
+#define STITCH_LINK_NULL -1
+
+/* a vertex of the isolines shared by all segments that meet at it. Every vertex lies on a cell 
+ * edge and each cell edge is shared by at most two cells, each of which generates at most one 
+ * segment ending at that vertex; thus each vertex has at most two links.
+ *
+ * vertices with a single link are the ends of open polylines; the only vertices which can have a
+ * single link are those on the boundary of the grid. */
+struct stitch_vertex_t
+{
+  /* grid space position of the vertex (unit: meters) */
+  struct point2d_t point;
+
+  /* indices of the (up to two) vertices this vertex is connected to; unused links are set to
+   * STITCH_LINK_NULL */
+  int links[2];
+
+  /* set once the vertex has been written to a polyline */
+  bool is_visited;
+};
+
+/*** SIMPLIFICATION ******************************************************************************/
+
+/* the tolerance of the simplification of the polylines (modes ISOLINES_EXTRACT_POLYLINES and 
+ * ISOLINES_EXTRACT_TRACE); vertices are dropped while the simplified polyline stays within this
+ * distance of every dropped vertex (Douglas-Peucker). Zero disables simplification. 
+ * (unit: meters) */
+#define ISOLINES_SIMPLIFY_TOLERANCE_M 0.05f
+
+/* the number of jobs the polylines of a threshold are split into for simplification */
+#define ISOLINES_SIMPLIFY_JOB_COUNT (ISOLINES_THREAD_COUNT * 4)
+
+/* the working memory of the simplification of one thread; grows as needed */
+struct simplify_scratch_t
+{
+  /* the spans of the polyline still to be simplified, as (first, last) vertex pairs */
+  int *stack;
+  int stack_capacity;
+
+  /* per vertex of the polyline being simplified; set for the vertices to keep */
+  bool *is_kept;
+  int is_kept_capacity;
+};
+
+/* the args of the simplification jobs */
+struct simplify_job_args_t
+{
+  struct isolines_context_t *ctx;
+  int threshold_id;
+};
+
+/*** TRACING *************************************************************************************/
+
+/* cell edges are identified by an index; vertical edges first, then horizontal edges:
+ *    vertical edge from sample (col, row) to (col, row + 1)   -> col * (SAMPLE_GRID_ROW_COUNT - 1) + row
+ *    horizontal edge from sample (col, row) to (col + 1, row) -> TRACE_VERTICAL_EDGE_COUNT + 
+ *                                                                   col * SAMPLE_GRID_ROW_COUNT + row
+ * the total number of edges is the same as the max number of stitch vertices (one per edge). */
+#define TRACE_VERTICAL_EDGE_COUNT (SAMPLE_GRID_COL_COUNT * (SAMPLE_GRID_ROW_COUNT - 1))
+#define TRACE_EDGE_COUNT STITCH_VERTEX_MAX_COUNT
+
+/* a seed for the contour tracer; the edge at which a contour was found */
+struct trace_seed_t
+{
+  int edge;
+  int threshold_id;
+};
+
+/*** NESTING *************************************************************************************/
+
+/* Isolines never cross, whether of the same threshold or of different thresholds, so the closed 
+ * polylines of all thresholds nest into a tree. Every closed polyline encloses at least one 
+ * sample so crosses the column of samples through it, and the tree is found by sweeping up each
+ * column of samples with the closed polylines the sweep is inside of on a stack: a crossing of 
+ * the polyline on top of the stack leaves it, and a crossing of any other polyline enters it; the
+ * parent of the polyline entered is the one on top of the stack.
+ *
+ *           c
+ *   +-------|-------+        sweeping up the column of samples c, the polyline a is entered 
+ *   |  a  +-|-+     |        (the stack is empty so it has no parent), then b (whose parent is 
+ *   |     | b |     |        a, on top of the stack), then b is left and lastly a.
+ *   |     +-|-+     |
+ *   +-------|-------+
+ *           ^
+ *
+ * The crossings are the vertices of the closed polylines on the vertical edges of the cells, 
+ * recorded as the polylines are built. They are sorted by a counting sort on their edges, which
+ * puts them in the order the cells are swept (column by column, bottom to top), and the few 
+ * crossings (of different thresholds) on the same edge by their y; so the nesting is linear in 
+ * the number of vertices. */
+
+/* a crossing of a closed polyline with a column of samples */
+struct nesting_crossing_t
+{
+  int edge;                 /* the vertical edge crossed (see 'get_vertical_edge') */
+  float y;
+  int polyline;             /* index into the polylines of all thresholds */
+};
+
+/*** BANDS ***************************************************************************************/
+
+/* An isoband is the region of the grid whose weights lie in [threshold_i, threshold_i+1); the 
+ * last band is unbounded above, [threshold_n, inf). The bands are extracted as indexed triangles
+ * with every vertex shared between all triangles (of all bands) which meet at it.
+ *
+ * each corner of a cell has a ternary state w.r.t a band; below, in or above it. A cell whose 
+ * corners are all in the same band is a single quad of that band. Any other cell is split into 
+ * four triangles about its centre, whose weight is the mean of the corners; the weight is taken as
+ * linear over each triangle, so the bands split each triangle exactly with no ambiguous cases 
+ * (unlike the cell lookup, whose saddles bands would otherwise have to agree on). The polygon of a
+ * band in a triangle is found by walking the triangle's boundary anticlockwise, emitting the 
+ * vertices which are in the band and the points where the weight crosses the bounds of the band
+ * along each edge (lerped, as the isolines are). The polygon is convex with at most 5 vertices, 
+ * so is triangulated as a fan.
+ *
+ *  TL +--------+ TR       e.g. the triangle {BL, BR, C}, with BR below the band, BL and C in it,
+ *     | \    / |          gives the polygon {BL, x0, x1, C}; x0 and x1 are the points where the
+ *     |   C    |          lower bound crosses the edges BL->BR and BR->C.
+ *     |  / \x1 |
+ *     | /   \  |          the points on the edges of the cell are shared with the neighbouring 
+ *  BL +----x0--+ BR       cells so the bands have no cracks, and lie on the isolines.
+ */
+
+#define BAND_COUNT THRESHOLD_COUNT
+
+#define BAND_COLOR_R 1.f
+#define BAND_COLOR_G 0.f
+#define BAND_COLOR_B 0.4f
+
+#define BAND_VERTEX_NULL -1
+
+/*** ADAPTIVE ************************************************************************************/
+
+/* in adaptive mode the grid is covered by a quadtree of nodes (square blocks of cells), from 
+ * roots of ADAPTIVE_ROOT_SIZE cells down to leaves of single cells. A node is subdivided only if 
+ * a threshold may cross it, which is decided from bounds on the weights over the node computed 
+ * from the globs alone, so no samples are needed to refine the tree; only the corners of the 
+ * leaves are sampled (on demand, as when tracing).
+ *
+ *   +-------+-------+---+---+          a node whose weight bounds exclude every threshold has no
+ *   |       |       |   |   |          isolines and is not subdivided; nodes near the isolines
+ *   |       |       +---+-+-+          are subdivided down to the cells of the grid.
+ *   |       |       |   +-+-+
+ *   +-------+-------+---+-+-+          since the leaves are the cells of the grid, the segments 
+ *   |       |       |       |          are those of the full grid, and adjacent leaves of any 
+ *   |       |       |       |          depth lerp their shared edges from the same samples, so 
+ *   |       |       |       |          there are no cracks between levels of the tree.
+ *   +-------+-------+-------+
+ */
+
+/* the size of the roots of the quadtree (unit: cells); a power of 2. Roots on the top and right 
+ * of the grid are clipped to the grid. */
+#define ADAPTIVE_ROOT_SIZE 16
+
+/* the relative margin by which the weight bounds of a node are widened, to cover the rounding 
+ * errors in the weights of its samples */
+#define ADAPTIVE_BOUND_MARGIN 1e-4f
+
+#define ADAPTIVE_LEAF_MAX_COUNT ((SAMPLE_GRID_COL_COUNT - 1) * (SAMPLE_GRID_ROW_COUNT - 1))
+
+/* a cell of the grid reached by the refinement, and the thresholds which may cross it */
+struct adaptive_leaf_t
+{
+  int16_t col, row;
+  uint32_t threshold_mask; /* bit i is set if threshold i may cross the cell */
+};
+
+/*** LEVEL OF DETAIL *****************************************************************************/
+
+/* when the cells of the grid are projected smaller than this on screen, the isolines mesh is 
+ * extracted from a coarser lattice of samples, every 'stride' samples (a power of 2), so the 
+ * projected size of its cells is at least this (unit: pixels) */
+#define ISOLINES_LOD_MIN_CELL_PX 4.f
+
+/* the largest stride of the lattice of samples */
+#define ISOLINES_LOD_MAX_STRIDE 8
+
+/*** CULLING *************************************************************************************/
+
+/* the number of cells beyond each edge of the view which are extracted with it, so the isolines 
+ * entering the view as it moves are already there */
+#define ISOLINES_VIEW_GUARD_CELLS 4
+
+/* while culled to the view, the whole grid is evaluated and extracted every this many ticks 
+ * instead, refreshing the isolines off-screen at a low rate for users of the whole mesh; 0 never
+ * refreshes them */
+#define ISOLINES_VIEW_REFRESH_TICKS 0
+
+/* a rectangle of cells [col0, col1) x [row0, row1) of the grid; its samples are those in 
+ * [col0, col1] x [row0, row1] */
+struct cell_region_t
+{
+  int col0, row0, col1, row1;
+};
+
+static const struct cell_region_t whole_grid_region = {
+  0, 0, SAMPLE_GRID_COL_COUNT - 1, SAMPLE_GRID_ROW_COUNT - 1
+};
+
+/*** DUAL ****************************************************************************************/
+
+/* The dual extraction (2d surface nets) places a single vertex in each cell the isoline crosses,
+ * rather than one on each crossed edge, and joins the vertices of every pair of cells which share
+ * a crossed edge with a segment; each vertex is shared by the (usually two) segments meeting at
+ * it, so the isolines have about half the vertices and are indexed lines.
+ *
+ *    +-----+-----+         the vertices (v) of the cells either side of each crossed edge (x) 
+ *    |     |  v  |         are joined; a saddle cell has a single vertex joining all four of its
+ *    |   v-x--|  |         crossed edges. The isolines end at the vertices of the cells on the 
+ *    +---|-+--x--+         border of the grid, half a cell short of it.
+ *    |   x |     |
+ *    |   | |     |
+ *    +-----+-----+
+ *
+ * The vertex is the mean of the crossing points of the cell (surface nets). Optionally it is
+ * placed instead by minimising its squared distance to the lines through each crossing point 
+ * along the isoline, i.e. perpendicular to the gradient of the field there (estimated by central
+ * differences of the samples), plus a small pull towards the mean so the placement is stable 
+ * where the lines are near parallel (a quadratic error function, as in dual contouring). This 
+ * keeps sharp corners of a field sharp, but the globs' field is smooth, and on it the mean lies 
+ * closer to the isoline. */
+
+/* when set the dual vertices are placed using the gradients of the field (see above) */
+#define ISOLINES_DUAL_USE_GRADIENTS 0
+
+/* the weight of the pull of a dual vertex towards the mean of its crossing points, relative to 
+ * the pull towards each line through a crossing point */
+#define ISOLINES_DUAL_MEAN_BIAS 0.1f
+
+#define DUAL_VERTEX_NULL -1
+
+/*** STREAMING ***********************************************************************************/
+
+/* a streaming extraction (see 'create_isolines_stream'); the lines of samples are pushed one at a
+ * time and extracted as the columns of cells between each line and the one before it, so only 
+ * the last two lines are kept. As for the column cache, each line's crossing points are lerped
+ * once and shared by the columns of cells on either side of it. Line i of the stream lies at
+ * x = i * cell_size_m and sample j of a line at y = j * cell_size_m. */
+struct isolines_stream_t
+{
+  int line_length;          /* unit: samples */
+  float cell_size_m;
+  float *thresholds;
+  int threshold_count;
+
+  /* the number of lines pushed so far */
+  int line_count;
+
+  /* the samples of the last line pushed and the line before it */
+  float *weights;
+  float *prev_weights;
+
+  /* the y coordinate of the crossing point of each threshold along each edge of the last line 
+   * pushed and the line before it, between samples j and j + 1 (element: 
+   * (threshold_id * (line_length - 1)) + j); only the elements of crossed edges are valid */
+  float *edge_points;
+  float *prev_edge_points;
+
+  /* the segments of the column of cells completed by the last push, threshold by threshold */
+  float *components;
+  int component_count;
+  int component_capacity;
+  int *level_offsets;       /* threshold_count + 1 elements */
+};
+
+/*** RASTERS *************************************************************************************/
+
+/* A raster (see 'extract_isolines_raster_r') too large to hold in memory is extracted a tile of 
+ * cells at a time. Each tile is read with an apron of one line of samples on its right and top, 
+ * which it shares with the tiles beside it, so every edge between two tiles is seen by both and 
+ * both lerp the same crossing point on it (from the bottom/left sample, as everywhere else).
+ *
+ * Each tile stitches its segments into pieces: polylines which either close within the tile or
+ * end on its border. The ends of the pieces on the seams between tiles are keyed by the edge 
+ * they lie on (unique over the whole raster), and once all tiles are extracted the pieces are 
+ * joined end to end through those keys into the final polylines.
+ *
+ *    +-----------+-----------+         the piece a of tile 0 ends on the edge k of the seam, as
+ *    |           |           |         does the piece b of tile 1; they are joined at k. 
+ *    |     a-----k-----b     |
+ *    |   tile 0  |  tile 1   |
+ *    +-----------+-----------+
+ *
+ * The tiles are jobs of the thread pool, and each job reads its own tile; while one thread waits
+ * on a read the others extract, and only one tile of samples per thread is held at a time. */
+
+/* the side length of a tile of a raster (unit: cells) */
+#define ISOLINES_RASTER_TILE_SIZE 256
+
+/* the key of a piece end that lies on the border of the raster, which no other piece shares */
+#define RASTER_KEY_NULL -1
+
+/* a piece of the polylines of a threshold extracted from a tile */
+struct raster_piece_t
+{
+  int threshold_id;
+  int first_vertex;         /* offset into the vertices of the tile (unit: vertices) */
+  int vertex_count;
+  bool is_closed;
+
+  /* the keys of the edges the first and last vertex lie on (open pieces only) */
+  int64_t keys[2];
+
+  /* set once the piece has been written to a polyline */
+  bool is_visited;
+};
+
+/* the pieces extracted from a tile, threshold by threshold */
+struct raster_tile_t
+{
+  GLfloat *vertices;        /* packed as {x, y} pairs (grid space) */
+  int component_count;
+  int component_capacity;
+
+  struct raster_piece_t *pieces;
+  int piece_count;
+  int piece_capacity;
+};
+
+/* the buffers a thread extracts a tile with */
+struct raster_scratch_t
+{
+  /* the samples of the tile (with its apron), column by column */
+  float *weights;
+  int weight_capacity;
+
+  /* the stitch vertex on each edge of the tile, or STITCH_LINK_NULL; the vertical edges are 
+   * numbered first, column by column, then the horizontal edges */
+  int *edge_vertex_ids;
+  int edge_vertex_id_capacity;
+
+  struct stitch_vertex_t *vertices;
+  int64_t *vertex_keys;     /* the key of the edge of each vertex; only valid on the tile border */
+  int vertex_count;
+  int vertex_capacity;
+  int vertex_key_capacity;
+};
+
+/* a seam edge and the (up to two) piece ends which lie on it */
+struct raster_seam_t
+{
+  int64_t key;              /* RASTER_KEY_NULL for an unused slot of the table */
+  int tiles[2];
+  int pieces[2];
+  int8_t ends[2];
+  int end_count;
+};
+
+/*** BATCH ***************************************************************************************/
+
+/* the cost aimed for by each job of a batch extraction (unit: cell extractions, i.e. cells x 
+ * thresholds); small fields are packed together into jobs of up to this cost, and large fields
+ * are split into strips of columns of about this cost, so the jobs are even enough for the pool 
+ * to balance however the sizes of the fields vary */
+#define ISOLINES_BATCH_JOB_COST 16384
+
+/* a job of a batch extraction; either a run of whole fields, or a strip of columns [col0, col1) 
+ * of a single field. For a run of whole fields col1 is INT_MAX and is clamped to each field. 
+ *
+ * The job counts (and then extracts) the segments of each level of each of its fields into its
+ * own run of slots, in field order and then level order; the slot of a level k of a field f is:
+ *    first_slot + (k - first level of field 'first_field') */
+struct batch_job_t
+{
+  int first_field;
+  int field_count;
+  int col0, col1;
+  int first_slot;
+  int first_state_mask;   /* the offset of the state masks of the job's cells (see 
+                           * 'place_batch_state_masks') */
+};
+
+/*** COMPONENTS **********************************************************************************/
+
+/* The connected regions of the grid at or above a threshold are labelled by union-find over the
+ * samples at or above it. The cell lookup cuts off the corners below the threshold, so the
+ * corners above it are always joined within a cell (even in the saddle cases), and the part of
+ * each cell at or above the threshold lies in a single region. Any two corners of a cell at or
+ * above the threshold (diagonals included) are thus joined, and a cell has the label of those 
+ * corners.
+ *
+ * The labelling runs on the thread pool with the same jobs as the parallel extraction, one per
+ * (threshold, strip of columns) pair, in passes:
+ *
+ *  1. label: each job joins the samples of its own strip through the cells between them; the
+ *     last column of cells of a strip, the seam, reaches into the next strip so is left.
+ *  2. merge: the cells of the seams are joined serially.
+ *  3. count: each job counts the roots of the sets in its strip; a prefix sum numbers them.
+ *  4. number: each job assigns the ids of its roots.
+ *  5. cells: each job labels its cells and sums their areas by region; the sums of the jobs are
+ *     added up serially.
+ *
+ * A set is always linked to the root with the lower sample index, so the roots, and so the ids 
+ * of the regions (in order of their first sample, column by column), do not depend on the order 
+ * of the unions or on the number of threads. */
+
+#define COMPONENT_CELL_COUNT ((SAMPLE_GRID_COL_COUNT - 1) * (SAMPLE_GRID_ROW_COUNT - 1))
+
+/* the width of the strips of the labelling (unit: cells) */
+#define COMPONENT_STRIP_WIDTH (((SAMPLE_GRID_COL_COUNT - 1) + ISOLINES_STRIP_COUNT - 1) / \
+                               ISOLINES_STRIP_COUNT)
+
+/* the parent of a sample below the threshold, and the label of a cell entirely below it */
+#define COMPONENT_NULL -1
+
+/* the sums of the cells of a region within a job */
+struct component_sums_t
+{
+  double area;
+  int cell_count;
+};
+
+/*** SEGMENT INDEX *******************************************************************************/
+
+/* The segments of the isolines mesh are indexed for hit-testing by binning them on the cells of
+ * the grid: each segment is put in the bin of the cell its midpoint lies in, by a counting sort, 
+ * so the segments of each bin are a contiguous run of the index. The index is built from the 
+ * (compacted) mesh at most once per tick, on the first query after the tick.
+ *
+ * A segment reaches at most half its length from its midpoint. A segment of a cell never reaches
+ * beyond its cell, and the adaptive mode refines down to single cells, but those of a coarse 
+ * lattice (level of detail) span several cells, so the queries search out to the longest half 
+ * length (the reach) beyond the bins the query itself touches. */
+
+#define SEGMENT_BIN_COL_COUNT (SAMPLE_GRID_COL_COUNT - 1)
+#define SEGMENT_BIN_ROW_COUNT (SAMPLE_GRID_ROW_COUNT - 1)
+#define SEGMENT_BIN_COUNT (SEGMENT_BIN_COL_COUNT * SEGMENT_BIN_ROW_COUNT)
+
+/* the number of query points of a batch handled by each job of the thread pool */
+#define SEGMENT_QUERY_JOB_SIZE 64
+
+/*** CONTEXT *************************************************************************************/
+
+/* all of the state of a simulation and its isolines; every function which touches state takes the
+ * context it works on, so any number of contexts can be created and ticked independently, each 
+ * on its own thread. A context owns its own thread pool (of ISOLINES_THREAD_COUNT threads), slab 
+ * pool and buffers; nothing is shared between contexts but the constant tables.
+ *
+ * the context is large (mostly the fixed size per grid scratch buffers) so is always heap
+ * allocated, by 'create_isolines_context'. */
+struct isolines_context_t
+{
+  /*** samples ***/
+
+  /* opengl 2.1 gfx data 
+   *
+   * each sample has a set of two vertex components (x and y) and a set of three color components
+   * (r, g, b).
+   *
+   * vertices and colors are stored as a flattened 2d array so each sample can access it's data
+   * as:
+   *    sample_data[(col * (col_size * components_per_sample)) + 
+   *                                         (row * components_per_sample) + component_id]
+   * where:
+   *    components_per_sample = 2 (for vertices), and = 3 (for colors)
+   *    component_id = 0(->x) or 1(->y) (for vertices), and = 0(->r) or 1(->g) or 2(->b) 
+   *                                                                                (for colors).
+   */
+  GLfloat sample_vertices[SAMPLE_COUNT * 2];
+  GLfloat sample_colors[SAMPLE_COUNT * 3];
+
+  /*** globbers ***/
+
+  /* the glob mesh drawn by opengl */
+  GLfloat glob_vertices[GLOB_MESH_RESOLUTION * 2];
+
+  /* the globbers that move around the grid, shaping the isolines */
+  struct globber_t globbers[GLOB_COUNT];
+
+  /* the state of the random numbers the globbers are generated from (see 'rand_r') */
+  unsigned int rand_seed;
+
+  /*** grid ***/
+
+  /* the simulation grid */
+  struct sample_grid_t grid;
+
+  /* the threshold (isovalues) to generate contour lines for; must be in ascending order. The 
+   * thresholds can be shifted at runtime (see 'shift_isolines_thresholds'). */
+  float thresholds[THRESHOLD_COUNT];
+
+  /* the form in which isolines are currently extracted and drawn */
+  enum isolines_extraction_mode_t extraction_mode;
+
+  /* the slabs of the isolines mesh, when built in slabs */
+  struct slab_mesh_t isolines_mesh_slabs;
+
+  /* vertex buffer to store generated sample grid mesh. Either a contiguous buffer which grows to
+   * fit the mesh, or (when ISOLINES_USE_MESH_SLABS is set) the open tail slab of the isolines mesh
+   * slabs. Either way there is no size limit, and the memory is kept between ticks, so once it has
+   * grown to fit the busiest scene no further allocations are made. */
+  struct mesh_chunk_t isolines_mesh;
+
+  /* the metrics sums of each level of the isolines mesh */
+  struct level_metrics_sums_t isolines_level_metrics[THRESHOLD_COUNT];
+
+  /* the offset of the segments of each threshold (level) in the isolines mesh, followed by the end
+   * of the mesh (unit: vertex components); the thresholds are extracted in turn so each level is a 
+   * contiguous run of the mesh. When the mesh is in pieces (slabs or tiles) the offsets are into 
+   * the mesh as compacted by 'compact_isolines_mesh'. */
+  int isolines_mesh_level_offsets[THRESHOLD_COUNT + 1];
+
+  /* the contiguous copy of the isolines mesh slabs, made by 'compact_isolines_mesh' */
+  struct mesh_chunk_t compacted_isolines_mesh;
+  bool is_isolines_mesh_compacted;
+
+  /* cell caches used to optimise cell processing (in function 'generate_isolines_mesh'). Avoids 
+   * the naive approach of performing every linear interpolation twice, which results from 
+   * processing all cells independently. Note that we only need to cache two columns at a time; the
+   * currently being processed column and the prior (left) column. This is because we process cells
+   * column per column, from bottom (row 0) to top (row max), and each cell only needs data from the
+   * cell below it or to the left of it to avoid duplicate lerps */
+  struct cell_t cell_column_cache[2][SAMPLE_GRID_ROW_COUNT];
 
-/* the current number of vertex components in the grid mesh */
-static int isolines_mesh_component_count;
+  /*** parallel ***/
 
-/* vertex buffer to store generated sample grid mesh */
-static GLfloat isolines_mesh[ISOLINES_MESH_MAX_SIZE];
+  /* the pool of threads the parallel extraction runs on */
+  struct pool isolines_pool;
 
-/* cell caches used to optimise cell processing (in function 'generate_isolines_mesh'). Avoids 
- * the naive approach of performing every linear interpolation twice, which results from processing
- * all cells independently. Note that we only need to cache two columns at a time; the currently
- * being processed column and the prior (left) column. This is because we process cells column per
- * column, from bottom (row 0) to top (row max), and each cell only needs data from the cell below
- * it or to the left of it to avoid duplicate lerps */
-static struct cell_t cell_column_cache[2][SAMPLE_GRID_ROW_COUNT];
+  /* the metrics sums of each job of the parallel extraction */
+  struct level_metrics_sums_t job_level_metrics[ISOLINES_JOB_COUNT];
+
+  /* every thread needs its own cell column cache */
+  struct cell_t thread_column_caches[ISOLINES_THREAD_COUNT][2][SAMPLE_GRID_ROW_COUNT];
+
+  /* the number of segments each job of the parallel extraction will generate (from the counting 
+   * pass) and the offset of each job's output in the isolines mesh (unit: vertex components) */
+  int job_segment_counts[ISOLINES_JOB_COUNT];
+  int job_offsets[ISOLINES_JOB_COUNT];
+
+  /*** slabs ***/
+
+  /* the slab pool; slabs of released meshes are kept here for reuse. The pool only ever grows, to 
+   * the number of slabs needed by the busiest tick so far, after which no more slabs are allocated.
+   * The pool is shared by the extraction jobs so access is locked; slabs are large so this is 
+   * rare. */
+  struct isolines_mesh_slab_t *free_slabs;
+  pthread_mutex_t free_slabs_mutex;
+
+  /* the meshes of the jobs of the parallel extraction, when built in slabs */
+  struct slab_mesh_t job_slab_meshes[ISOLINES_JOB_COUNT];
+
+  /*** pyramid ***/
+
+  /* min/max pyramid over the grid samples. Level 1 stores the weight range of every tile of 
+   * PYRAMID_TILE_SIZE x PYRAMID_TILE_SIZE cells, level 2 the range of every block of 
+   * PYRAMID_BLOCK_SIZE x PYRAMID_BLOCK_SIZE cells. The range of a tile (or block) includes the 
+   * samples on its boundary, i.e. the corners of all cells within it. Tiles and blocks on the top
+   * and right of the grid may be partial.
+   *
+   *    +-------------------+-------------------+
+   *    | tile  | tile  |   |                   |      an isoline can only pass through a region
+   *    +-------+-------+   |                   |      if its range straddles the threshold, thus
+   *    | tile  | tile  |   |       block       |      the extraction can skip any tile (or whole 
+   *    +-------+-------+   |                   |      block) which is entirely above or entirely
+   *    |                   |                   |      below the threshold.
+   *    +-------------------+-------------------+
+   */
+  struct weight_range_t pyramid_tiles[PYRAMID_TILE_COL_COUNT][PYRAMID_TILE_ROW_COUNT];
+  struct weight_range_t pyramid_blocks[PYRAMID_BLOCK_COL_COUNT][PYRAMID_BLOCK_ROW_COUNT];
+
+  /* scratch buffer for sorting tiles (see 'sort_tiles') */
+  struct tile_sort_entry_t tile_sort_entries[PYRAMID_TILE_COL_COUNT * PYRAMID_TILE_ROW_COUNT];
+
+  /*** span space ***/
+
+  /* when the field is frozen it does not change between ticks, thus the span space index only needs
+   * to be built once, and only the thresholds can change */
+  bool is_field_frozen;
+
+  /* every node stores at least one tile so there can be no more nodes than tiles */
+  struct span_node_t span_nodes[SPAN_TILE_COUNT];
+  int span_node_count;
+  int span_root;
+
+  int span_tiles_by_min[SPAN_TILE_COUNT];
+  int span_tiles_by_max[SPAN_TILE_COUNT];
+
+  /* scratch buffers for building and querying the index */
+  int span_build_tiles[SPAN_TILE_COUNT];
+  int span_build_scratch[SPAN_TILE_COUNT];
+  int span_query_tiles[SPAN_TILE_COUNT];
+
+  /*** remeshing ***/
+
+  /* the isolines mesh of each tile of cells (the same tiles as the pyramid) of all thresholds; kept
+   * between ticks and replaced only when the tile is dirty */
+  struct mesh_chunk_t tile_meshes[PYRAMID_TILE_COL_COUNT][PYRAMID_TILE_ROW_COUNT];
+
+  /* the level offsets (see 'isolines_mesh_level_offsets') of each tile mesh */
+  int tile_mesh_level_offsets[PYRAMID_TILE_COL_COUNT][PYRAMID_TILE_ROW_COUNT][THRESHOLD_COUNT + 1];
+
+  /* the metrics sums of each level of each tile mesh; the sums of a level are the sum over tiles */
+  struct level_metrics_sums_t tile_level_metrics[PYRAMID_TILE_COL_COUNT][PYRAMID_TILE_ROW_COUNT]
+                                                [THRESHOLD_COUNT];
+
+  /* the weights of the samples of each tile as they were when the tile was last extracted; stored 
+   * per tile since samples on the border of a tile are shared with the neighbouring tiles, which 
+   * may have been extracted at different ticks. Accessed [tile_col][tile_row][col][row] with the
+   * sample col and row relative to the tile. */
+  float tile_extracted_weights[PYRAMID_TILE_COL_COUNT][PYRAMID_TILE_ROW_COUNT]
+                              [PYRAMID_TILE_SIZE + 1][PYRAMID_TILE_SIZE + 1];
+
+  /* set for the tiles whose meshes are stale regardless of the samples, i.e. the thresholds 
+   * changed or the tiles have not been extracted yet */
+  bool stale_tiles[PYRAMID_TILE_COL_COUNT][PYRAMID_TILE_ROW_COUNT];
+
+  /* the number of ticks each tile has been dirty for without being re-extracted; a tile's priority
+   * rises with it so tiles far from the focus are not starved by a busy region near it */
+  int tile_wait_ticks[PYRAMID_TILE_COL_COUNT][PYRAMID_TILE_ROW_COUNT];
+
+  /* the point (grid space) the dirty tiles nearest to are re-extracted first; the centre of the 
+   * view is a good choice */
+  struct point2d_t remesh_focus_g_m;
+
+  /* the tiles to re-extract this tick, as tile ids (tile_col * PYRAMID_TILE_ROW_COUNT + tile_row),
+   * in order of priority */
+  int dirty_tiles[REMESH_TILE_COUNT];
+  int dirty_tile_count;
+
+  /* the number of dirty tiles re-extracted this tick, of 'dirty_tile_count' */
+  int remeshed_tile_count;
+
+  /* measures the time spent remeshing each tick */
+  struct clock remesh_clock;
+
+  /*** stitching ***/
+
+  /* the vertices generated for the threshold currently being stitched, in creation order */
+  struct stitch_vertex_t stitch_vertices[STITCH_VERTEX_MAX_COUNT];
+  int stitch_vertex_count;
+
+  /* the cell edge (see 'get_cell_edge') each stitch vertex lies on */
+  int stitch_vertex_edges[STITCH_VERTEX_MAX_COUNT];
+
+  /* the current number of vertex components in the polyline mesh */
+  int isolines_polyline_mesh_component_count;
+  int isolines_polyline_mesh_capacity;
+
+  /* vertex buffer to store the generated polylines; each polyline is a contiguous run of vertices,
+   * closed polylines do not repeat their first vertex. Grows as needed. */
+  GLfloat *isolines_polyline_mesh;
+
+  /* the generated polylines, grouped by threshold in the order of the thresholds array */
+  struct isoline_polyline_t *isolines_polylines;
+  int isolines_polyline_count;
+  int isolines_polyline_capacity;
+
+  /* offsets into the polylines array of the first polyline of each threshold; the polylines of
+   * threshold i are in the range [offsets[i], offsets[i + 1]) */
+  int isolines_polyline_threshold_offsets[THRESHOLD_COUNT + 1];
+
+  /* the metrics sums of the polyline being built, and the length weighted sum of the midpoints of 
+   * its segments */
+  struct level_metrics_sums_t polyline_metrics;
+  double polyline_line_centroid_x, polyline_line_centroid_y;
+
+  /*** simplification ***/
+
+  struct simplify_scratch_t simplify_scratches[ISOLINES_THREAD_COUNT];
+
+  /*** tracing ***/
+
+  /* incremented every tick in trace and adaptive modes; a sample whose stamp matches has already 
+   * been evaluated this tick (see 'get_lazy_sample_weight') */
+  uint32_t tick_stamp;
+  uint32_t sample_stamps[SAMPLE_GRID_COL_COUNT][SAMPLE_GRID_ROW_COUNT];
+
+  /* incremented for every threshold traced; an edge whose stamp matches has already been added to
+   * a contour of the current threshold. Stamps avoid having to clear the arrays, which would cost
+   * time proportional to the grid area. */
+  uint32_t trace_stamp;
+  uint32_t edge_trace_stamps[TRACE_EDGE_COUNT];
+
+  /* scratch buffers of the edges crossed when walking a contour forwards and backwards from its
+   * start edge */
+  int trace_forward_edges[TRACE_EDGE_COUNT];
+  int trace_backward_edges[TRACE_EDGE_COUNT];
+
+  /* the seeds of the contours traced in the previous tick and in the current tick; the previous 
+   * tick's contours are used to seed the current tick's tracing */
+  struct trace_seed_t *prev_trace_seeds;
+  struct trace_seed_t *trace_seeds;
+  int prev_trace_seed_count, prev_trace_seed_capacity;
+  int trace_seed_count, trace_seed_capacity;
+
+  /*** nesting ***/
+
+  /* the crossings of the closed polylines with the columns of samples, as they are recorded and 
+   * as sorted by edge */
+  struct nesting_crossing_t *nesting_crossings;
+  struct nesting_crossing_t *sorted_nesting_crossings;
+  int nesting_crossing_count;
+  int nesting_crossing_capacity;
+  int sorted_nesting_crossing_capacity;
+
+  /* the sorted crossings of the vertical edge i are [nesting_edge_offsets[i], 
+   * nesting_edge_offsets[i + 1]) */
+  int nesting_edge_offsets[TRACE_VERTICAL_EDGE_COUNT + 1];
+
+  /* the closed polylines the sweep of a column is inside of, innermost last */
+  int *nesting_stack;
+  int nesting_stack_capacity;
+
+  /*** bands ***/
+
+  /* the vertex ids of the points on the sample grid shared by the cells of adjacent columns (the 
+   * vertical edges and corners of the cells) are cached for two sample columns; the left and right
+   * sides of the column of cells being swept. The points on the horizontal edges are shared only 
+   * by the cells of the column, so are cached for one column. The ids are per threshold since an
+   * edge is crossed by at most one point per threshold. */
+  int band_corner_ids[2][SAMPLE_GRID_ROW_COUNT];
+  int band_vertical_edge_ids[2][SAMPLE_GRID_ROW_COUNT - 1][THRESHOLD_COUNT];
+  int band_horizontal_edge_ids[SAMPLE_GRID_ROW_COUNT][THRESHOLD_COUNT];
+
+  /* the vertex ids of the centre of the cell being extracted and the points on its diagonals */
+  int band_center_id;
+  int band_diagonal_ids[4][THRESHOLD_COUNT];
+
+  /* the vertices of all bands packed as {x, y} pairs (grid space) */
+  GLfloat *isoband_vertices;
+  int isoband_vertex_count;
+  int isoband_vertex_capacity;
+
+  /* the triangle vertex indices of each band */
+  GLuint *isoband_indices[BAND_COUNT];
+  int isoband_index_counts[BAND_COUNT];
+  int isoband_index_capacities[BAND_COUNT];
+
+  /*** adaptive ***/
+
+  struct adaptive_leaf_t adaptive_leaves[ADAPTIVE_LEAF_MAX_COUNT];
+  int adaptive_leaf_count;
+
+  /*** level of detail ***/
+
+  /* the stride of the lattice chosen for the current view (see 'set_isolines_pixel_size'); only 
+   * used in mode ISOLINES_EXTRACT_SEGMENTS while the field is not frozen */
+  int lod_stride;
+
+  /* the stride of the lattice the isolines mesh of the last tick was extracted from */
+  int isolines_mesh_stride;
+
+  /*** culling ***/
+
+  /* the rectangle of the grid in view (see 'set_isolines_view_rect'); only used in mode 
+   * ISOLINES_EXTRACT_SEGMENTS while the field is not frozen */
+  bool is_view_culled;
+  struct point2d_t view_min_g_m, view_max_g_m;
+  int view_refresh_tick;
+
+  /* the cells the isolines mesh of the last tick was extracted from */
+  struct cell_region_t isolines_mesh_region;
+
+  /*** dual ***/
+
+  /* the vertices of the dual isolines of all thresholds packed as {x, y} pairs (grid space) */
+  GLfloat *dual_vertices;
+  int dual_vertex_count;
+  int dual_vertex_capacity;
+
+  /* the vertex index pairs of the segments of all thresholds, threshold by threshold; those of a 
+   * threshold i are [dual_threshold_offsets[i], dual_threshold_offsets[i + 1]) */
+  GLuint *dual_indices;
+  int dual_index_count;
+  int dual_index_capacity;
+  int dual_threshold_offsets[THRESHOLD_COUNT + 1];
+
+  /* the vertex of each cell of the column being extracted and the column left of it (or 
+   * DUAL_VERTEX_NULL if the isoline does not cross the cell) */
+  int dual_column_vertex_ids[2][SAMPLE_GRID_ROW_COUNT - 1];
+
+  /*** rasters ***/
+
+  /* the raster being extracted (see 'extract_isolines_raster_r'), its tiles and whether any read
+   * of a tile failed */
+  const struct isolines_raster_t *raster;
+  int raster_tile_col_count;
+  int raster_tile_row_count;
+  bool is_raster_read_failed;
+
+  struct raster_tile_t *raster_tiles;
+  int raster_tile_capacity;
+  struct raster_scratch_t raster_scratches[ISOLINES_THREAD_COUNT];
+
+  /* the table of the seams of a threshold, open addressed by key; the capacity is a power of 2 */
+  struct raster_seam_t *raster_seams;
+  int raster_seam_table_size;
+  int raster_seam_capacity;
+
+  /* the polylines of a threshold i of the last raster are [raster_threshold_offsets[i],
+   * raster_threshold_offsets[i + 1]) of the polylines */
+  int *raster_threshold_offsets;
+  int raster_threshold_offset_capacity;
+  int raster_threshold_count;
+
+  /*** batch ***/
+
+  /* the fields and output of the batch extraction in progress (see 'extract_isolines_batch_r') */
+  const struct isolines_field_t *batch_fields;
+  struct isolines_batch_t *batch;
+
+  struct batch_job_t *batch_jobs;
+  int batch_job_count;
+  int batch_job_capacity;
+
+  /* the segment count and mesh offset of each slot of the jobs */
+  int *batch_slot_counts;
+  int *batch_slot_offsets;
+  int batch_slot_count_capacity;
+  int batch_slot_offset_capacity;
+
+  /* the state masks of the cells of every level of the jobs, written by the count pass and read
+   * by the fill pass */
+  uint8_t *batch_state_masks;
+  int batch_state_mask_capacity;
+
+  /* the crossing points of the edges of two columns of cells of a field, for each thread (see 
+   * 'generate_field_segments') */
+  float *batch_edge_points[ISOLINES_THREAD_COUNT];
+  int batch_edge_point_capacities[ISOLINES_THREAD_COUNT];
+
+  /*** components ***/
+
+  /* the union-find forest of the samples of each threshold, by sample index
+   * (col * SAMPLE_GRID_ROW_COUNT + row); COMPONENT_NULL for the samples below the threshold */
+  int component_parents[THRESHOLD_COUNT][SAMPLE_COUNT];
+
+  /* the id of the region of each root of the forest */
+  int component_root_ids[THRESHOLD_COUNT][SAMPLE_COUNT];
+
+  /* the region of each cell, by cell index (col * (SAMPLE_GRID_ROW_COUNT - 1) + row) */
+  int component_labels[THRESHOLD_COUNT][COMPONENT_CELL_COUNT];
+
+  /* the regions of all thresholds; those of a threshold i are [component_threshold_offsets[i],
+   * component_threshold_offsets[i + 1]) */
+  struct isolines_component_t *components;
+  int component_capacity;
+  int component_threshold_offsets[THRESHOLD_COUNT + 1];
+
+  /* the number of roots in the strip of each job, the id of its first root, and its sums by
+   * region (of its threshold) */
+  int job_component_counts[ISOLINES_JOB_COUNT];
+  int job_component_offsets[ISOLINES_JOB_COUNT];
+  struct component_sums_t *job_component_sums[ISOLINES_JOB_COUNT];
+  int job_component_sum_capacities[ISOLINES_JOB_COUNT];
+
+  /*** segment index ***/
+
+  /* the segments (by index into the isolines mesh) of a bin b are [segment_bin_offsets[b], 
+   * segment_bin_offsets[b + 1]) of the binned segments; bins are indexed as the cells, 
+   * (col * SEGMENT_BIN_ROW_COUNT) + row */
+  int segment_bin_offsets[SEGMENT_BIN_COUNT + 1];
+  int *binned_segments;
+  int binned_segment_capacity;
+
+  /* the bin of each segment, kept between the passes of the counting sort */
+  int *segment_bins;
+  int segment_bin_capacity;
+
+  /* the mesh indexed, and the longest half length of its segments (unit: meters) */
+  const float *indexed_mesh;
+  float segment_reach_m;
+  bool is_segment_index_built;
+
+  /* the batch of queries in progress (grid space) and their results */
+  struct point2d_t *segment_queries;
+  int segment_query_capacity;
+  int segment_query_count;
+  float segment_query_radius_m;
+  struct isolines_segment_hit_t *segment_hits;
+
+  /* the segments found within the radius of a query i are [segment_query_offsets[i], 
+   * segment_query_offsets[i + 1]) of the found segments; the count of each query is written to
+   * the offset of the next by the first pass */
+  int *segment_query_offsets;
+  int segment_query_offset_capacity;
+  int *found_segments;
+  int found_segment_capacity;
+};
 
 /*** SAMPLES *************************************************************************************/
 
 static void
-set_sample_vertex(int sample_col, int sample_row, float x_g, float y_g);
+set_sample_vertex(struct isolines_context_t *ctx, int sample_col, int sample_row, float x_g,
+                  float y_g);
 
 static void
-init_sample_gfx_data(void)
+init_sample_gfx_data(struct isolines_context_t *ctx)
 {
   float sx_g, sy_g;
 
@@ -470,17 +1483,18 @@ init_sample_gfx_data(void)
       sx_g = (float)col * (float)CELL_SIZE_M;
       sy_g = (float)row * (float)CELL_SIZE_M;
 
-      set_sample_vertex(col, row, sx_g, sy_g);
+      set_sample_vertex(ctx, col, row, sx_g, sy_g);
     }
   }
 
   /* set every color component of every sample to the same value; all colors grey */
   for(int i = 0; i < (SAMPLE_COUNT * 3); i++)
-    sample_colors[i] = SAMPLE_INACTIVE_GREY;
+    ctx->sample_colors[i] = SAMPLE_INACTIVE_GREY;
 }
 
 static void
-set_sample_vertex(int sample_col, int sample_row, float x_g, float y_g)
+set_sample_vertex(struct isolines_context_t *ctx, int sample_col, int sample_row, float x_g,
+                  float y_g)
 {
   assert(0 <= sample_col && sample_col < SAMPLE_GRID_COL_COUNT);
   assert(0 <= sample_row && sample_row < SAMPLE_GRID_ROW_COUNT);
@@ -488,12 +1502,12 @@ set_sample_vertex(int sample_col, int sample_row, float x_g, float y_g)
   int sample_offset = ((sample_col * SAMPLE_GRID_ROW_COUNT * SAMPLE_VERTEX_COMPONENT_COUNT) +
                        (sample_row * SAMPLE_VERTEX_COMPONENT_COUNT));
 
-  sample_vertices[sample_offset + SAMPLE_VERTEX_X_OFFSET] = x_g;
-  sample_vertices[sample_offset + SAMPLE_VERTEX_Y_OFFSET] = y_g;
+  ctx->sample_vertices[sample_offset + SAMPLE_VERTEX_X_OFFSET] = x_g;
+  ctx->sample_vertices[sample_offset + SAMPLE_VERTEX_Y_OFFSET] = y_g;
 }
 
 static struct point2d_t
-get_sample_vertex(int sample_col, int sample_row)
+get_sample_vertex(struct isolines_context_t *ctx, int sample_col, int sample_row)
 {
   assert(0 <= sample_col && sample_col < SAMPLE_GRID_COL_COUNT);
   assert(0 <= sample_row && sample_row < SAMPLE_GRID_ROW_COUNT);
@@ -502,13 +1516,14 @@ get_sample_vertex(int sample_col, int sample_row)
                        (sample_row * SAMPLE_VERTEX_COMPONENT_COUNT));
 
   return (struct point2d_t){
-    sample_vertices[sample_offset + SAMPLE_VERTEX_X_OFFSET],
-    sample_vertices[sample_offset + SAMPLE_VERTEX_Y_OFFSET]
+    ctx->sample_vertices[sample_offset + SAMPLE_VERTEX_X_OFFSET],
+    ctx->sample_vertices[sample_offset + SAMPLE_VERTEX_Y_OFFSET]
   };
 }
 
 static void
-set_sample_color(int sample_col, int sample_row, float r, float g, float b)
+set_sample_color(struct isolines_context_t *ctx, int sample_col, int sample_row, float r, float g,
+                 float b)
 {
   assert(0 <= sample_col && sample_col < SAMPLE_GRID_COL_COUNT);
   assert(0 <= sample_row && sample_row < SAMPLE_GRID_ROW_COUNT);
@@ -516,9 +1531,9 @@ set_sample_color(int sample_col, int sample_row, float r, float g, float b)
   int sample_offset = ((sample_col * SAMPLE_GRID_ROW_COUNT * SAMPLE_COLOR_COMPONENT_COUNT) +
                        (sample_row * SAMPLE_COLOR_COMPONENT_COUNT));
 
-  sample_colors[sample_offset + SAMPLE_COLOR_R_OFFSET] = r;
-  sample_colors[sample_offset + SAMPLE_COLOR_G_OFFSET] = g;
-  sample_colors[sample_offset + SAMPLE_COLOR_B_OFFSET] = b;
+  ctx->sample_colors[sample_offset + SAMPLE_COLOR_R_OFFSET] = r;
+  ctx->sample_colors[sample_offset + SAMPLE_COLOR_G_OFFSET] = g;
+  ctx->sample_colors[sample_offset + SAMPLE_COLOR_B_OFFSET] = b;
 }
 
 /* weight function to calculate the weight contribution from a single glob */
@@ -541,14 +1556,14 @@ calculate_sample_weight(struct point2d_t sample_pos_g, struct globber_t *glob)
 
 /* sums the weight contributions from all globs */
 static float
-calculate_sample_weights_sum(struct point2d_t sample_pos_g_m)
+calculate_sample_weights_sum(struct isolines_context_t *ctx, struct point2d_t sample_pos_g_m)
 {
   struct globber_t *glob;
   float weight = 0.f;
 
   for(int i = 0; i < GLOB_COUNT; i++)
   {
-    glob = &globbers[i]; 
+    glob = &ctx->globbers[i]; 
     weight += calculate_sample_weight(sample_pos_g_m, glob);
   }
 
@@ -601,13 +1616,19 @@ weight_to_color(float weight, float *r, float *g, float *b)
 }
 
 static void
-draw_samples(void)
+draw_samples(struct isolines_context_t *ctx)
 {
   glEnableClientState(GL_COLOR_ARRAY);
   glPointSize(SAMPLE_DRAW_DIAMETER_PX);
-  glVertexPointer(2, GL_FLOAT, 0, sample_vertices);
-  glColorPointer(3, GL_FLOAT, 0, sample_colors);
-  glDrawArrays(GL_POINTS, 0, SAMPLE_COUNT);
+  glVertexPointer(2, GL_FLOAT, 0, ctx->sample_vertices);
+  glColorPointer(3, GL_FLOAT, 0, ctx->sample_colors);
+
+  /* only the samples of the cells extracted are up to date; the samples of a column are 
+   * contiguous */
+  for(int col = ctx->isolines_mesh_region.col0; col <= ctx->isolines_mesh_region.col1; col++)
+    glDrawArrays(GL_POINTS, (col * SAMPLE_GRID_ROW_COUNT) + ctx->isolines_mesh_region.row0, 
+                 ctx->isolines_mesh_region.row1 - ctx->isolines_mesh_region.row0 + 1);
+
   glPointSize(1.f);
 }
 
@@ -615,32 +1636,32 @@ draw_samples(void)
 
 /* the glob mesh is a simple circle of radius 1 centered about a local origin */
 static void
-generate_glob_mesh(void)
+generate_glob_mesh(struct isolines_context_t *ctx)
 {
   float angle_rad = 0.f, delta_angle_rad = 2 * M_PI / GLOB_MESH_RESOLUTION; 
   int i = 0;
   while(i != GLOB_MESH_RESOLUTION * 2)
   {
-    glob_vertices[i++] = cos(angle_rad);
-    glob_vertices[i++] = sin(angle_rad);
+    ctx->glob_vertices[i++] = cos(angle_rad);
+    ctx->glob_vertices[i++] = sin(angle_rad);
     angle_rad += delta_angle_rad; 
   }
 }
 
 static void
-rand_direction(struct vector2d_t *direction)
+rand_direction(unsigned int *seed, struct vector2d_t *direction)
 {
   static const int angle_resolution = 100;
   static const float angle_quantum_rad = (2 * M_PI) / (float)angle_resolution;
 
-  float angle_rad = (rand() % angle_resolution) * angle_quantum_rad;
+  float angle_rad = (rand_r(seed) % angle_resolution) * angle_quantum_rad;
 
   direction->x = cos(angle_rad);
   direction->y = sin(angle_rad);
 }
 
 static void
-rand_position_and_radius(struct point2d_t *pos_g_m, float *radius_m)
+rand_position_and_radius(unsigned int *seed, struct point2d_t *pos_g_m, float *radius_m)
 {
   static const int pos_resolution = 400;
   static const int radius_resolution = 100;
@@ -648,25 +1669,25 @@ rand_position_and_radius(struct point2d_t *pos_g_m, float *radius_m)
 
   float pos_x_quantum_g_m, pos_y_quantum_g_m;
 
-  *radius_m = ((rand() % radius_resolution) * radius_quantum_m) + GLOB_MIN_RADIUS_M;
+  *radius_m = ((rand_r(seed) % radius_resolution) * radius_quantum_m) + GLOB_MIN_RADIUS_M;
 
   pos_x_quantum_g_m = (sample_grid_width_m - (2 * (*radius_m))) / (float)pos_resolution;
   pos_y_quantum_g_m = (sample_grid_height_m - (2 * (*radius_m))) / (float)pos_resolution;
 
-  pos_g_m->x = ((rand() % pos_resolution) * pos_x_quantum_g_m) + (*radius_m);
-  pos_g_m->y = ((rand() % pos_resolution) * pos_y_quantum_g_m) + (*radius_m);
+  pos_g_m->x = ((rand_r(seed) % pos_resolution) * pos_x_quantum_g_m) + (*radius_m);
+  pos_g_m->y = ((rand_r(seed) % pos_resolution) * pos_y_quantum_g_m) + (*radius_m);
 }
 
 /* generates a random set of globbers to roam the simulation */
 static void
-generate_globs(void)
+generate_globs(struct isolines_context_t *ctx)
 {
-  srand(time(NULL));
-
   for(int i = 0; i < GLOB_COUNT; i++)
   {
-    rand_direction(&(globbers[i].dir));
-    rand_position_and_radius(&(globbers[i].center_g_m), &(globbers[i].radius_m));
+    rand_direction(&ctx->rand_seed, &(ctx->globbers[i].dir));
+    rand_position_and_radius(&ctx->rand_seed, 
+                             &(ctx->globbers[i].center_g_m), 
+                             &(ctx->globbers[i].radius_m));
   }
 }
 
@@ -704,13 +1725,13 @@ handle_glob_collisions(struct globber_t *glob)
 }
 
 static void
-tick_globs(void)
+tick_globs(struct isolines_context_t *ctx)
 {
   struct globber_t *glob;
 
   for(int i = 0; i < GLOB_COUNT; i++)
   {
-    glob = &globbers[i]; 
+    glob = &ctx->globbers[i]; 
     glob->center_g_m.x += glob->dir.x * GLOB_POS_DELTA_M;
     glob->center_g_m.y += glob->dir.y * GLOB_POS_DELTA_M;
 
@@ -719,17 +1740,17 @@ tick_globs(void)
 }
 
 static void
-draw_globs(void)
+draw_globs(struct isolines_context_t *ctx)
 {
   struct globber_t *glob;
 
   glDisableClientState(GL_COLOR_ARRAY);
   glColor3f(GLOB_COLOR_R, GLOB_COLOR_G, GLOB_COLOR_B);
   glLineWidth(GLOB_DRAW_WIDTH_PX);
-  glVertexPointer(2, GL_FLOAT, 0, glob_vertices);
+  glVertexPointer(2, GL_FLOAT, 0, ctx->glob_vertices);
   for(int i = 0; i < GLOB_COUNT; i++)
   {
-    glob = &globbers[i]; 
+    glob = &ctx->globbers[i]; 
     glPushMatrix();
     glTranslatef(glob->center_g_m.x, glob->center_g_m.y, 0.f);
     glScalef(glob->radius_m, glob->radius_m, glob->radius_m);
@@ -742,164 +1763,5469 @@ draw_globs(void)
 /*** GRID ****************************************************************************************/
 
 static void
-init_grid(struct point2d_t grid_pos_w_m)
+init_grid(struct isolines_context_t *ctx, struct point2d_t grid_pos_w_m)
 {
-  grid.pos_w_m = grid_pos_w_m;
+  ctx->grid.pos_w_m = grid_pos_w_m;
 
   /* zero all sample weights */
-  memset((void *)grid.samples, 0, sizeof(struct sample_t) * SAMPLE_GRID_COL_COUNT * SAMPLE_GRID_ROW_COUNT);
+  memset((void *)ctx->grid.samples, 0,
+         sizeof(struct sample_t) * SAMPLE_GRID_COL_COUNT * SAMPLE_GRID_ROW_COUNT);
 }
 
-static inline void
-reset_isolines_mesh()
+/* computes the weight range of the rectangle of samples [col0, col1] x [row0, row1] (inclusive) */
+static struct weight_range_t
+compute_sample_range(struct isolines_context_t *ctx, int col0, int row0, int col1, int row1)
 {
-  isolines_mesh_component_count = 0;
+  struct weight_range_t range = {INFINITY, -INFINITY};
+  float weight;
+
+  for(int col = col0; col <= col1; col++)
+  {
+    for(int row = row0; row <= row1; row++)
+    {
+      weight = ctx->grid.samples[col][row].weight;
+      range.min = fminf(range.min, weight);
+      range.max = fmaxf(range.max, weight);
+    }
+  }
+
+  return range;
 }
 
-/* generates a vertex mesh from the sample grid; uses marching cubes. The mesh will consist of
- * a set of disconnected lines. */
+/* rebuilds the min/max pyramid from the current sample weights; the tiles overlapping the region
+ * are built from the samples and the blocks from the tiles. A tile or block partly outside the 
+ * region may include samples which were not updated, which can only widen its range, so it is 
+ * still never skipped by an isoline crossing the region. */
 static void
-generate_isolines_mesh(float threshold)
+build_pyramid(struct isolines_context_t *ctx, const struct cell_region_t *region)
 {
-  struct point2d_t point;
-  struct cell_t *current_cell, *bottom_cell, *left_cell;
-  struct sample_t samples[4];
-  struct cell_t *left_column_cache, *current_column_cache;
-  bool cell_column_cache_id = 0; /* bool used to easily flip between 0 and 1 */
-
-  left_column_cache = NULL;
-  current_column_cache = cell_column_cache[(int)cell_column_cache_id];
+  struct weight_range_t *block, *tile;
+  int col0, row0, col1, row1;
 
-  for(int col = 0; col < (SAMPLE_GRID_COL_COUNT - 1); col++)
+  for(int tile_col = region->col0 / PYRAMID_TILE_SIZE; 
+      tile_col * PYRAMID_TILE_SIZE < region->col1; 
+      tile_col++)
   {
-    for(int row = 0; row < (SAMPLE_GRID_ROW_COUNT - 1); row++)
+    for(int tile_row = region->row0 / PYRAMID_TILE_SIZE; 
+        tile_row * PYRAMID_TILE_SIZE < region->row1; 
+        tile_row++)
     {
-      samples[CELL_WEIGHT_BL].weight = grid.samples[col  ][row  ].weight;
-      samples[CELL_WEIGHT_BR].weight = grid.samples[col+1][row  ].weight;
-      samples[CELL_WEIGHT_TR].weight = grid.samples[col+1][row+1].weight;
-      samples[CELL_WEIGHT_TL].weight = grid.samples[col  ][row+1].weight;
-
-      current_cell = &current_column_cache[row];
+      col0 = tile_col * PYRAMID_TILE_SIZE;
+      row0 = tile_row * PYRAMID_TILE_SIZE;
+      col1 = col0 + PYRAMID_TILE_SIZE;
+      row1 = row0 + PYRAMID_TILE_SIZE;
+      col1 = (col1 < SAMPLE_GRID_COL_COUNT) ? col1 : SAMPLE_GRID_COL_COUNT - 1;
+      row1 = (row1 < SAMPLE_GRID_ROW_COUNT) ? row1 : SAMPLE_GRID_ROW_COUNT - 1;
+
+      ctx->pyramid_tiles[tile_col][tile_row] = compute_sample_range(ctx, col0, row0, col1, row1);
+    }
+  }
 
-      compute_cell(samples, threshold, current_cell); 
+  for(int block_col = 0; block_col < PYRAMID_BLOCK_COL_COUNT; block_col++)
+  {
+    for(int block_row = 0; block_row < PYRAMID_BLOCK_ROW_COUNT; block_row++)
+    {
+      block = &ctx->pyramid_blocks[block_col][block_row];
+      block->min = INFINITY;
+      block->max = -INFINITY;
+
+      for(int tile_col = block_col * (PYRAMID_BLOCK_SIZE / PYRAMID_TILE_SIZE); 
+          tile_col < (block_col + 1) * (PYRAMID_BLOCK_SIZE / PYRAMID_TILE_SIZE) && 
+          tile_col < PYRAMID_TILE_COL_COUNT; 
+          tile_col++)
+      {
+        for(int tile_row = block_row * (PYRAMID_BLOCK_SIZE / PYRAMID_TILE_SIZE); 
+            tile_row < (block_row + 1) * (PYRAMID_BLOCK_SIZE / PYRAMID_TILE_SIZE) && 
+            tile_row < PYRAMID_TILE_ROW_COUNT; 
+            tile_row++)
+        {
+          tile = &ctx->pyramid_tiles[tile_col][tile_row];
+          block->min = fminf(block->min, tile->min);
+          block->max = fmaxf(block->max, tile->max);
+        }
+      }
+    }
+  }
+}
 
-      bottom_cell = (row > 0) ? &current_column_cache[row - 1] : NULL;
-      left_cell = (left_column_cache != NULL) ? &left_column_cache[row] : NULL;
+/* true if an isoline of the threshold may pass through a region with the weight range; that is
+ * if the region has both active (>= threshold) and inactive (< threshold) samples */
+static inline bool
+is_range_crossed(struct weight_range_t range, float threshold)
+{
+  return (range.min < threshold) && (threshold <= range.max);
+}
 
-      lerp_cell(threshold, current_cell, bottom_cell, left_cell);
+/* the number of rows of cells, from the cell (col, row) upwards, that the pyramid shows cannot be
+ * crossed by an isoline of the threshold; zero if the cell may be crossed. The pyramid is only
+ * consulted when the row is the first of a tile, so this can be called for every cell of a column
+ * in turn (skipping the returned number of rows) to skip whole tiles and blocks.
+ *
+ * note - skipped cells are not written to the cell column cache so leave stale data there. This 
+ *   is safe since a skipped cell has no points, so the cells to the right of and above it have no
+ *   points coincident with it, thus never read it. */
+static int
+get_pyramid_skip_rows(struct isolines_context_t *ctx, int col, int row, float threshold)
+{
+  if(row % PYRAMID_TILE_SIZE != 0)
+    return 0;
 
-      for(int i = 0; i < 4; i++)
+  if((row % PYRAMID_BLOCK_SIZE == 0) && 
+     !is_range_crossed(ctx->pyramid_blocks[col / PYRAMID_BLOCK_SIZE][row / PYRAMID_BLOCK_SIZE],
+                       threshold))
+    return PYRAMID_BLOCK_SIZE;
+
+  if(!is_range_crossed(ctx->pyramid_tiles[col / PYRAMID_TILE_SIZE][row / PYRAMID_TILE_SIZE],
+                       threshold))
+    return PYRAMID_TILE_SIZE;
+
+  return 0;
+}
+
+/* the cells [col0, col1) x [row0, row1) of a tile of the pyramid */
+static void
+get_tile_region(int tile_col, int tile_row, int *col0, int *row0, int *col1, int *row1)
+{
+  *col0 = tile_col * PYRAMID_TILE_SIZE;
+  *row0 = tile_row * PYRAMID_TILE_SIZE;
+  *col1 = *col0 + PYRAMID_TILE_SIZE;
+  *row1 = *row0 + PYRAMID_TILE_SIZE;
+  *col1 = (*col1 < SAMPLE_GRID_COL_COUNT - 1) ? *col1 : SAMPLE_GRID_COL_COUNT - 1;
+  *row1 = (*row1 < SAMPLE_GRID_ROW_COUNT - 1) ? *row1 : SAMPLE_GRID_ROW_COUNT - 1;
+}
+
+/* the index (col or row) of the sample after 'index' in a lattice of 'stride' over 'count' 
+ * samples; the lattice always includes the last sample, so its last step may be short. Returns
+ * 'count' after the last sample. */
+static inline int
+get_next_lattice_index(int index, int stride, int count)
+{
+  return (index < count - 1 && index + stride > count - 1) ? count - 1 : index + stride;
+}
+
+static inline int
+clamp_index(int index, int min, int max)
+{
+  return (index < min) ? min : (index > max) ? max : index;
+}
+
+/* the cells in view (with the guard band) for the extraction from the lattice of 'stride'; the 
+ * region is widened to the lattice, and cut to the grid since the view may be partly (or wholly)
+ * off the grid */
+static void
+get_view_region(struct isolines_context_t *ctx, int stride, struct cell_region_t *region)
+{
+  region->col0 = (int)floorf(ctx->view_min_g_m.x / CELL_SIZE_M) - ISOLINES_VIEW_GUARD_CELLS;
+  region->row0 = (int)floorf(ctx->view_min_g_m.y / CELL_SIZE_M) - ISOLINES_VIEW_GUARD_CELLS;
+  region->col1 = (int)ceilf(ctx->view_max_g_m.x / CELL_SIZE_M) + ISOLINES_VIEW_GUARD_CELLS;
+  region->row1 = (int)ceilf(ctx->view_max_g_m.y / CELL_SIZE_M) + ISOLINES_VIEW_GUARD_CELLS;
+
+  region->col0 = clamp_index(region->col0, 0, SAMPLE_GRID_COL_COUNT - 1);
+  region->row0 = clamp_index(region->row0, 0, SAMPLE_GRID_ROW_COUNT - 1);
+  region->col0 -= region->col0 % stride;
+  region->row0 -= region->row0 % stride;
+
+  region->col1 += (stride - (region->col1 % stride)) % stride;
+  region->row1 += (stride - (region->row1 % stride)) % stride;
+  region->col1 = clamp_index(region->col1, region->col0, SAMPLE_GRID_COL_COUNT - 1);
+  region->row1 = clamp_index(region->row1, region->row0, SAMPLE_GRID_ROW_COUNT - 1);
+}
+
+/*** METRICS *************************************************************************************/
+
+static inline void
+reset_level_metrics(struct level_metrics_sums_t *sums)
+{
+  sums->length = sums->area2 = sums->centroid6_x = sums->centroid6_y = 0.0;
+  sums->min = (struct point2d_t){INFINITY, INFINITY};
+  sums->max = (struct point2d_t){-INFINITY, -INFINITY};
+}
+
+/* adds the directed segment p0 -> p1 of the boundary of the region of a level to the area and 
+ * centroid sums; the region must be on the left of the segment */
+static inline void
+add_boundary_metrics(struct level_metrics_sums_t *sums, struct point2d_t p0, struct point2d_t p1)
+{
+  double cross = ((double)p0.x * p1.y) - ((double)p1.x * p0.y);
+
+  sums->area2 += cross;
+  sums->centroid6_x += ((double)p0.x + p1.x) * cross;
+  sums->centroid6_y += ((double)p0.y + p1.y) * cross;
+}
+
+/* adds an isoline segment p0 -> p1 of a cell to the sums, with the point p0 on the side 'side0'
+ * (CELL_POINT_*) of the cell. The cell lookup does not orient its segments, so the orientation is
+ * found from the state mask: walking anticlockwise around the cell from side0 to the side of p1 
+ * passes the corners on the right of the segment, the first of which (the corner anticlockwise 
+ * of side0) has the same index as the side. If it is active the segment is reversed, so the 
+ * region is always on its left. */
+static void
+add_segment_metrics(struct level_metrics_sums_t *sums, struct point2d_t p0, struct point2d_t p1,
+                    uint8_t state_mask, int8_t side0)
+{
+  float dx = p1.x - p0.x, dy = p1.y - p0.y;
+
+  sums->length += sqrtf((dx * dx) + (dy * dy));
+  sums->min.x = fminf(sums->min.x, fminf(p0.x, p1.x));
+  sums->min.y = fminf(sums->min.y, fminf(p0.y, p1.y));
+  sums->max.x = fmaxf(sums->max.x, fmaxf(p0.x, p1.x));
+  sums->max.y = fmaxf(sums->max.y, fmaxf(p0.y, p1.y));
+
+  if(state_mask & (1 << side0))
+    add_boundary_metrics(sums, p1, p0);
+  else
+    add_boundary_metrics(sums, p0, p1);
+}
+
+/* adds the parts of the border of the cells extracted ('cells') inside the region of the 
+ * threshold to the sums; this closes the regions cut by the border, which the isolines leave 
+ * open. The border is walked through the samples of the lattice of 'stride' the isolines were 
+ * extracted from, and its pieces are added anticlockwise so the region is on the left:
+ *
+ *            <- side 2
+ *    (col0, row1) +-----+ (col1, row1)
+ *         |       |     |       ^
+ *       side 3    |     |     side 1
+ *         v       |     |       |
+ *    (col0, row0) +-----+ (col1, row0)
+ *            side 0 ->
+ *
+ * every side is walked up the lattice (which is not symmetric, since its last step may be short)
+ * and the pieces of the top and left sides are reversed. */
+static void
+add_border_metrics(struct isolines_context_t *ctx, struct level_metrics_sums_t *sums,
+                   float threshold, int stride, 
+                   const struct cell_region_t *cells)
+{
+  const int side_lines[4] = {cells->row0, cells->col1, cells->row1, cells->col0};
+
+  struct point2d_t p0, p1, crossing;
+  int col0, row0, col1, row1, first, last, next;
+  bool is_vertical;
+  float w0, w1, t;
+
+  for(int side = 0; side < 4; side++)
+  {
+    is_vertical = (side % 2 == 1);
+    first = is_vertical ? cells->row0 : cells->col0;
+    last = is_vertical ? cells->row1 : cells->col1;
+
+    for(int i = first; i < last; i = next)
+    {
+      next = get_next_lattice_index(i, stride, is_vertical ? SAMPLE_GRID_ROW_COUNT 
+                                                           : SAMPLE_GRID_COL_COUNT);
+      col0 = is_vertical ? side_lines[side] : i;
+      row0 = is_vertical ? i : side_lines[side];
+      col1 = is_vertical ? side_lines[side] : next;
+      row1 = is_vertical ? next : side_lines[side];
+
+      w0 = ctx->grid.samples[col0][row0].weight;
+      w1 = ctx->grid.samples[col1][row1].weight;
+      p0 = (struct point2d_t){col0 * CELL_SIZE_M, row0 * CELL_SIZE_M};
+      p1 = (struct point2d_t){col1 * CELL_SIZE_M, row1 * CELL_SIZE_M};
+
+      /* only the part of the piece inside the region is on its boundary */
+      if((w0 >= threshold) != (w1 >= threshold))
       {
-        if(current_cell->indices[i] == CELL_POINT_NULL)
-        {
-          /* ensure indicies come in pairs as intended */
-          assert(i % 2 == 0); 
+        t = (threshold - w0) / (w1 - w0);
+        crossing.x = p0.x + ((p1.x - p0.x) * t);
+        crossing.y = p0.y + ((p1.y - p0.y) * t);
+        if(w0 >= threshold)
+          p1 = crossing;
+        else
+          p0 = crossing;
+      }
 
-          /* no more indicies */
-          break;
-        }
-        
-        /* local cell space point */
-        point = current_cell->points[current_cell->indices[i]];
+      if(w0 < threshold && w1 < threshold)
+        continue;
+
+      if(side < 2)
+        add_boundary_metrics(sums, p0, p1);
+      else
+        add_boundary_metrics(sums, p1, p0);
+    }
+  }
+}
+
+/* adds the sums 'other' to the sums */
+static inline void
+merge_level_metrics(struct level_metrics_sums_t *sums, const struct level_metrics_sums_t *other)
+{
+  sums->length += other->length;
+  sums->area2 += other->area2;
+  sums->centroid6_x += other->centroid6_x;
+  sums->centroid6_y += other->centroid6_y;
+  sums->min.x = fminf(sums->min.x, other->min.x);
+  sums->min.y = fminf(sums->min.y, other->min.y);
+  sums->max.x = fmaxf(sums->max.x, other->max.x);
+  sums->max.y = fmaxf(sums->max.y, other->max.y);
+}
+
+/*** SLABS ***************************************************************************************/
+
+/* takes a slab from the pool, allocating a new one only if the pool is empty */
+static struct isolines_mesh_slab_t *
+acquire_mesh_slab(struct isolines_context_t *ctx)
+{
+  struct isolines_mesh_slab_t *slab;
+
+  pthread_mutex_lock(&ctx->free_slabs_mutex);
+  slab = ctx->free_slabs;
+  if(slab != NULL)
+    ctx->free_slabs = slab->next;
+  pthread_mutex_unlock(&ctx->free_slabs_mutex);
+
+  if(slab == NULL)
+    slab = xmalloc(sizeof(struct isolines_mesh_slab_t));
+
+  slab->next = NULL;
+  slab->component_count = 0;
+
+  return slab;
+}
+
+/* returns all slabs of the mesh to the pool and empties the mesh */
+static void
+release_slab_mesh(struct isolines_context_t *ctx, struct slab_mesh_t *mesh)
+{
+  if(mesh->head != NULL)
+  {
+    pthread_mutex_lock(&ctx->free_slabs_mutex);
+    mesh->tail->next = ctx->free_slabs;
+    ctx->free_slabs = mesh->head;
+    pthread_mutex_unlock(&ctx->free_slabs_mutex);
+  }
+
+  mesh->head = mesh->tail = NULL;
+  mesh->component_count = 0;
+}
+
+/* moves all slabs of the mesh 'other' onto the end of the mesh; no components are copied. Both
+ * meshes must be closed (i.e. any chunks writing to them must be closed). */
+static void
+append_slab_mesh(struct slab_mesh_t *mesh, struct slab_mesh_t *other)
+{
+  if(other->head == NULL)
+    return;
+
+  if(mesh->head == NULL)
+    mesh->head = other->head;
+  else
+    mesh->tail->next = other->head;
+
+  mesh->tail = other->tail;
+  mesh->component_count += other->component_count;
+
+  other->head = other->tail = NULL;
+  other->component_count = 0;
+}
+
+/* points a chunk at the end of a slab mesh; writes to the chunk then append to the mesh. No slab
+ * is linked until the first write, so empty chunks add no (empty) slabs to the mesh. */
+static void
+open_slab_mesh_chunk(struct slab_mesh_t *mesh, struct mesh_chunk_t *chunk)
+{
+  chunk->components = NULL;
+  chunk->component_count = 0;
+  chunk->capacity = 0;
+  chunk->growth = MESH_CHUNK_SLABS;
+  chunk->slab_mesh = mesh;
+}
+
+/* records the components written to the chunk's current slab in the slab and the mesh */
+static void
+close_slab_mesh_chunk(struct mesh_chunk_t *chunk)
+{
+  assert(chunk->growth == MESH_CHUNK_SLABS);
+
+  if(chunk->components != NULL)
+  {
+    chunk->slab_mesh->tail->component_count = chunk->component_count;
+    chunk->slab_mesh->component_count += chunk->component_count;
+  }
+
+  chunk->components = NULL;
+  chunk->component_count = 0;
+  chunk->capacity = 0;
+}
+
+/* makes room for more components in a full chunk */
+static void
+grow_mesh_chunk(struct isolines_context_t *ctx, struct mesh_chunk_t *chunk)
+{
+  struct isolines_mesh_slab_t *slab;
 
-        /* translate to grid space */
-        point.x += col * CELL_SIZE_M;
-        point.y += row * CELL_SIZE_M;
+  switch(chunk->growth)
+  {
+  case MESH_CHUNK_FIXED:
+    /* fixed size chunks are sized exactly so can never be full */
+    assert(0);
+    break;
+  case MESH_CHUNK_REALLOC:
+    chunk->components = xreserve(chunk->components, &chunk->capacity, chunk->component_count + 2,
+                                 sizeof(GLfloat));
+    break;
+  case MESH_CHUNK_SLABS:
+    close_slab_mesh_chunk(chunk);
+
+    slab = acquire_mesh_slab(ctx);
+    if(chunk->slab_mesh->head == NULL)
+      chunk->slab_mesh->head = slab;
+    else
+      chunk->slab_mesh->tail->next = slab;
+    chunk->slab_mesh->tail = slab;
+
+    chunk->components = slab->components;
+    chunk->capacity = ISOLINES_MESH_SLAB_SIZE;
+    break;
+  }
+}
+
+/* appends components to the compacted isolines mesh; it must have been reserved to fit */
+static inline void
+push_compacted_components(struct isolines_context_t *ctx, const GLfloat *components,
+                          int component_count)
+{
+  assert(ctx->compacted_isolines_mesh.component_count + component_count <= 
+         ctx->compacted_isolines_mesh.capacity);
+
+  if(component_count == 0)
+    return;
+
+  struct mesh_chunk_t *mesh = &ctx->compacted_isolines_mesh;
+  memcpy((void *)&mesh->components[mesh->component_count],
+         (void *)components,
+         sizeof(GLfloat) * component_count);
+  mesh->component_count += component_count;
+}
+
+/* copies the pieces of the isolines mesh (the slabs, or the tile meshes when remeshing 
+ * incrementally) into one contiguous buffer; done at most once per tick */
+static void
+compact_isolines_mesh(struct isolines_context_t *ctx)
+{
+  struct isolines_mesh_slab_t *slab;
+  int component_count, *offsets;
+
+  if(ctx->is_isolines_mesh_compacted)
+    return;
+
+  if(ctx->extraction_mode == ISOLINES_EXTRACT_INCREMENTAL)
+  {
+    component_count = 0;
+    for(int tile_col = 0; tile_col < PYRAMID_TILE_COL_COUNT; tile_col++)
+      for(int tile_row = 0; tile_row < PYRAMID_TILE_ROW_COUNT; tile_row++)
+        component_count += ctx->tile_meshes[tile_col][tile_row].component_count;
+  }
+  else
+    component_count = ctx->isolines_mesh_slabs.component_count;
 
-        /* add point to the mesh */
-        isolines_mesh[isolines_mesh_component_count++] = point.x;
-        isolines_mesh[isolines_mesh_component_count++] = point.y;
+  ctx->compacted_isolines_mesh.components = xreserve(ctx->compacted_isolines_mesh.components, 
+                                                     &ctx->compacted_isolines_mesh.capacity,
+                                                     component_count, 
+                                                     sizeof(GLfloat));
+  ctx->compacted_isolines_mesh.component_count = 0;
 
-        /* inform the user if the mesh is too large; will need to increase the size limit define 
-         * to handle the current simulation parameters */
-        if(isolines_mesh_component_count > (ISOLINES_MESH_MAX_SIZE - 2))
+  /* the tile meshes are compacted level by level, so each level is contiguous */
+  if(ctx->extraction_mode == ISOLINES_EXTRACT_INCREMENTAL)
+  {
+    for(int i = 0; i < THRESHOLD_COUNT; i++)
+    {
+      ctx->isolines_mesh_level_offsets[i] = ctx->compacted_isolines_mesh.component_count;
+      for(int tile_col = 0; tile_col < PYRAMID_TILE_COL_COUNT; tile_col++)
+      {
+        for(int tile_row = 0; tile_row < PYRAMID_TILE_ROW_COUNT; tile_row++)
         {
-          fprintf(stderr, "fatal: the generated isolines mesh is too large for the vertex buffer\n"
-                          "info: increase the buffer size by changing the define:\n"
-                          "                  ISOLINES_MESH_MAX_SIZE\n");
-          printf("generated vertex component count: %d\n", isolines_mesh_component_count);
-          exit(EXIT_FAILURE);
+          offsets = ctx->tile_mesh_level_offsets[tile_col][tile_row];
+          push_compacted_components(ctx,
+                                    &ctx->tile_meshes[tile_col][tile_row].components[offsets[i]],
+                                    offsets[i + 1] - offsets[i]);
         }
       }
     }
+    ctx->isolines_mesh_level_offsets[THRESHOLD_COUNT] = 
+      ctx->compacted_isolines_mesh.component_count;
+  }
+  else
+  {
+    for(slab = ctx->isolines_mesh_slabs.head; slab != NULL; slab = slab->next)
+      push_compacted_components(ctx, slab->components, slab->component_count);
+  }
+
+  ctx->is_isolines_mesh_compacted = true;
+}
+
+static inline void
+reset_isolines_mesh(struct isolines_context_t *ctx)
+{
+  for(int i = 0; i < THRESHOLD_COUNT; i++)
+    reset_level_metrics(&ctx->isolines_level_metrics[i]);
+
+  if(ISOLINES_USE_MESH_SLABS)
+  {
+    release_slab_mesh(ctx, &ctx->isolines_mesh_slabs);
+    open_slab_mesh_chunk(&ctx->isolines_mesh_slabs, &ctx->isolines_mesh);
+    ctx->is_isolines_mesh_compacted = false;
+  }
+  else
+    ctx->isolines_mesh.component_count = 0;
+}
+
+/* the number of vertex components in the isolines mesh so far */
+static inline int
+get_isolines_mesh_component_count(struct isolines_context_t *ctx)
+{
+  if(ISOLINES_USE_MESH_SLABS)
+    return ctx->isolines_mesh_slabs.component_count + ctx->isolines_mesh.component_count;
+  else
+    return ctx->isolines_mesh.component_count;
+}
+
+/* records the start of the segments of a threshold (level) in the isolines mesh; called before
+ * the threshold is extracted */
+static inline void
+begin_isolines_mesh_level(struct isolines_context_t *ctx, int threshold_id)
+{
+  ctx->isolines_mesh_level_offsets[threshold_id] = get_isolines_mesh_component_count(ctx);
+  ctx->isolines_mesh.metrics = &ctx->isolines_level_metrics[threshold_id];
+}
+
+/* completes the isolines mesh once all thresholds have been extracted */
+static inline void
+finish_isolines_mesh(struct isolines_context_t *ctx)
+{
+  if(ISOLINES_USE_MESH_SLABS)
+    close_slab_mesh_chunk(&ctx->isolines_mesh);
+
+  ctx->isolines_mesh_level_offsets[THRESHOLD_COUNT] = get_isolines_mesh_component_count(ctx);
+  ctx->isolines_mesh.metrics = NULL;
+
+  for(int i = 0; i < THRESHOLD_COUNT; i++)
+    add_border_metrics(ctx, &ctx->isolines_level_metrics[i], ctx->thresholds[i], 
+                       ctx->isolines_mesh_stride, &ctx->isolines_mesh_region);
+
+  if(ISOLINES_USE_MESH_SLABS && ISOLINES_COMPACT_MESH_SLABS)
+    compact_isolines_mesh(ctx);
+}
+
+/* appends a point to a mesh chunk; the chunk grows when full */
+static inline void
+push_mesh_chunk_point(struct isolines_context_t *ctx, struct mesh_chunk_t *chunk,
+                      struct point2d_t point)
+{
+  if(UNLIKELY(chunk->component_count > (chunk->capacity - 2)))
+    grow_mesh_chunk(ctx, chunk);
+
+  chunk->components[chunk->component_count++] = point.x;
+  chunk->components[chunk->component_count++] = point.y;
+}
+
+/* the cell being extracted by 'generate_isolines_mesh_region', and where its segments go */
+struct cell_kernel_t
+{
+  struct isolines_context_t *ctx;
+  struct mesh_chunk_t *chunk;
+  float threshold;
+  float weights[4];               /* in the order of the corners of the state mask */
+  struct cell_t *cell;
+  const struct cell_t *bottom;    /* NULL on the bottom row of the region */
+  const struct cell_t *left;      /* NULL on the left column of the region */
+  int col, row;
+};
+
+/* the grid space point of the cell on a side, as lerped by 'lerp_cell'; the right and top points
+ * are kept in the cell for the cells to its right and above to reuse. The side is a constant at
+ * every call, so each inlined call reduces to the straight-line lerp of its side. */
+static inline struct point2d_t
+lerp_cell_kernel_point(struct cell_kernel_t *kernel, int side)
+{
+  const float *w = kernel->weights;
+  struct point2d_t point;
+
+  switch(side)
+  {
+  case CELL_POINT_L:
+    point.x = 0.f;
+    point.y = (kernel->left != NULL) ? kernel->left->points[CELL_POINT_R].y : 
+                                       lerp(kernel->threshold, w[CELL_WEIGHT_BL], 
+                                            w[CELL_WEIGHT_TL], CELL_SIZE_M);
+    break;
+  case CELL_POINT_B:
+    point.x = (kernel->bottom != NULL) ? kernel->bottom->points[CELL_POINT_T].x : 
+                                         lerp(kernel->threshold, w[CELL_WEIGHT_BL], 
+                                              w[CELL_WEIGHT_BR], CELL_SIZE_M);
+    point.y = 0.f;
+    break;
+  case CELL_POINT_R:
+    point.x = CELL_SIZE_M;
+    point.y = lerp(kernel->threshold, w[CELL_WEIGHT_BR], w[CELL_WEIGHT_TR], CELL_SIZE_M);
+    kernel->cell->points[CELL_POINT_R] = point;
+    break;
+  default: /* CELL_POINT_T */
+    point.x = lerp(kernel->threshold, w[CELL_WEIGHT_TL], w[CELL_WEIGHT_TR], CELL_SIZE_M);
+    point.y = CELL_SIZE_M;
+    kernel->cell->points[CELL_POINT_T] = point;
+    break;
+  }
+
+  point.x += kernel->col * CELL_SIZE_M;
+  point.y += kernel->row * CELL_SIZE_M;
+
+  return point;
+}
+
+/* emits the segment of the cell from the point on side0 to the point on side1 */
+static inline void
+emit_cell_kernel_segment(struct cell_kernel_t *kernel, uint8_t state_mask, int side0, int side1)
+{
+  struct point2d_t p0 = lerp_cell_kernel_point(kernel, side0);
+  struct point2d_t p1 = lerp_cell_kernel_point(kernel, side1);
+
+  push_mesh_chunk_point(kernel->ctx, kernel->chunk, p0);
+  push_mesh_chunk_point(kernel->ctx, kernel->chunk, p1);
+  if(kernel->chunk->metrics != NULL)
+    add_segment_metrics(kernel->chunk->metrics, p0, p1, state_mask, side0);
+}
+
+/* a case of the lookup table as a kernel of its own; expands to the segments of the case, in the
+ * order of the table, so each case lerps and emits exactly its points with no loop over its 
+ * indices. The cases must match 'cell_lookup'. */
+#define CELL_KERNEL_0(state_mask)                                                                 \
+  case state_mask:                                                                                \
+    break;
+#define CELL_KERNEL_1(state_mask, side0, side1)                                                   \
+  case state_mask:                                                                                \
+    emit_cell_kernel_segment(kernel, state_mask, side0, side1);                                   \
+    break;
+#define CELL_KERNEL_2(state_mask, side0, side1, side2, side3)                                     \
+  case state_mask:                                                                                \
+    emit_cell_kernel_segment(kernel, state_mask, side0, side1);                                   \
+    emit_cell_kernel_segment(kernel, state_mask, side2, side3);                                   \
+    break;
+
+/* extracts the segments of a cell of the given case; the replacement of 'lerp_cell' and the loop
+ * over the indices of the cell in the extraction of the isolines mesh */
+static inline void
+run_cell_kernel(struct cell_kernel_t *kernel, uint8_t state_mask)
+{
+  switch(state_mask)
+  {
+  CELL_KERNEL_0(0)
+  CELL_KERNEL_1(1 , CELL_POINT_L, CELL_POINT_B)
+  CELL_KERNEL_1(2 , CELL_POINT_B, CELL_POINT_R)
+  CELL_KERNEL_1(3 , CELL_POINT_L, CELL_POINT_R)
+  CELL_KERNEL_1(4 , CELL_POINT_R, CELL_POINT_T)
+  CELL_KERNEL_2(5 , CELL_POINT_L, CELL_POINT_T, CELL_POINT_B, CELL_POINT_R)
+  CELL_KERNEL_1(6 , CELL_POINT_B, CELL_POINT_T)
+  CELL_KERNEL_1(7 , CELL_POINT_L, CELL_POINT_T)
+  CELL_KERNEL_1(8 , CELL_POINT_L, CELL_POINT_T)
+  CELL_KERNEL_1(9 , CELL_POINT_B, CELL_POINT_T)
+  CELL_KERNEL_2(10, CELL_POINT_L, CELL_POINT_B, CELL_POINT_R, CELL_POINT_T)
+  CELL_KERNEL_1(11, CELL_POINT_R, CELL_POINT_T)
+  CELL_KERNEL_1(12, CELL_POINT_L, CELL_POINT_R)
+  CELL_KERNEL_1(13, CELL_POINT_B, CELL_POINT_R)
+  CELL_KERNEL_1(14, CELL_POINT_L, CELL_POINT_B)
+  CELL_KERNEL_0(15)
+  }
+}
+
+/* generates a vertex mesh from the cells [col0, col1) x [row0, row1) of the sample grid and 
+ * appends it to the chunk; uses marching squares. The mesh will consist of a set of disconnected
+ * lines. The column cache must not be in use by any other thread.
+ *
+ * the cells on the left and bottom of the region lerp all of their points, since their left and 
+ * bottom neighbours are not processed; the results are identical (bit for bit) to the lerps the
+ * neighbours would have made, since they lerp the same edge from the same samples. */
+static void
+generate_isolines_mesh_region(struct isolines_context_t *ctx, float threshold, int col0, int row0,
+                              int col1, int row1,
+                              struct cell_t (*column_cache)[SAMPLE_GRID_ROW_COUNT],
+                              struct mesh_chunk_t *chunk)
+{
+  struct cell_kernel_t kernel;
+  struct cell_t *left_column_cache, *current_column_cache;
+  bool cell_column_cache_id = 0; /* bool used to easily flip between 0 and 1 */
+  uint8_t state_mask;
+  int skip_rows;
+
+  kernel.ctx = ctx;
+  kernel.chunk = chunk;
+  kernel.threshold = threshold;
+
+  left_column_cache = NULL;
+  current_column_cache = column_cache[(int)cell_column_cache_id];
+
+  for(int col = col0; col < col1; col++)
+  {
+    kernel.col = col;
+    for(int row = row0; row < row1; row++)
+    {
+      /* skip the tiles and blocks no isoline of the threshold passes through */
+      skip_rows = get_pyramid_skip_rows(ctx, col, row, threshold);
+      if(skip_rows > 0)
+      {
+        row += skip_rows - 1;
+        continue;
+      }
+
+      kernel.weights[CELL_WEIGHT_BL] = ctx->grid.samples[col  ][row  ].weight;
+      kernel.weights[CELL_WEIGHT_BR] = ctx->grid.samples[col+1][row  ].weight;
+      kernel.weights[CELL_WEIGHT_TR] = ctx->grid.samples[col+1][row+1].weight;
+      kernel.weights[CELL_WEIGHT_TL] = ctx->grid.samples[col  ][row+1].weight;
+
+      state_mask = get_cell_state_mask(kernel.weights, threshold);
+
+      kernel.row = row;
+      kernel.cell = &current_column_cache[row - row0];
+      kernel.bottom = (row > row0) ? &current_column_cache[row - row0 - 1] : NULL;
+      kernel.left = (left_column_cache != NULL) ? &left_column_cache[row - row0] : NULL;
+
+      run_cell_kernel(&kernel, state_mask);
+    }
 
     /* swap the caches so we will overrite the old left column with the next column of cells we
      * are due to process in the next loop iteration; only need to cache two columns */
     left_column_cache = current_column_cache;
     cell_column_cache_id = !cell_column_cache_id;
-    current_column_cache = cell_column_cache[(int)cell_column_cache_id];
+    current_column_cache = column_cache[(int)cell_column_cache_id];
   }
 
-  /* uncomment to check the mesh vertex buffer is large enough */
-  //printf("generated vertex component count: %d\n", isolines_mesh_component_count);
+  assert(chunk->component_count % 2 == 0);
+}
 
-  assert(isolines_mesh_component_count % 2 == 0);
+static inline int
+get_vertical_edge(int col, int row)
+{
+  return (col * (SAMPLE_GRID_ROW_COUNT - 1)) + row;
 }
 
-static void
-tick_grid(void)
+static inline int
+get_horizontal_edge(int col, int row)
 {
-  struct point2d_t sample_pos_g_m;
-  float r, g, b;
-  float *weight;
+  return TRACE_VERTICAL_EDGE_COUNT + (col * SAMPLE_GRID_ROW_COUNT) + row;
+}
 
-  for(int col = 0; col < SAMPLE_GRID_COL_COUNT; col++)
+/* the edge on the side 'side' (one of CELL_POINT_L/B/R/T) of the cell (col, row) */
+static int
+get_cell_edge(int col, int row, int8_t side)
+{
+  switch(side)
   {
-    for(int row = 0; row < SAMPLE_GRID_ROW_COUNT; row++)
-    {
-      weight = &grid.samples[col][row].weight;
-      sample_pos_g_m = get_sample_vertex(col, row);
-      *weight = calculate_sample_weights_sum(sample_pos_g_m);
-      weight_to_color(*weight, &r, &g, &b);
-      set_sample_color(col, row, r, g, b);
-    }
+  case CELL_POINT_L:
+    return get_vertical_edge(col, row);
+  case CELL_POINT_B:
+    return get_horizontal_edge(col, row);
+  case CELL_POINT_R:
+    return get_vertical_edge(col + 1, row);
+  case CELL_POINT_T:
+    return get_horizontal_edge(col, row + 1);
   }
+  assert(0);
+  return -1;
 }
 
-static void
-draw_isolines_mesh(void)
+static inline void
+reset_isolines_polylines(struct isolines_context_t *ctx)
 {
-  glDisableClientState(GL_COLOR_ARRAY);
-  glColor3f(ISOLINES_MESH_COLOR_R, ISOLINES_MESH_COLOR_G, ISOLINES_MESH_COLOR_B);
-  glLineWidth(ISOLINES_MESH_DRAW_WIDTH_PX);
-  glVertexPointer(2, GL_FLOAT, 0, isolines_mesh);
-  glDrawArrays(GL_LINES, 0, isolines_mesh_component_count >> 1);
-  glLineWidth(1.f);
+  ctx->isolines_polyline_mesh_component_count = 0;
+  ctx->isolines_polyline_count = 0;
+  ctx->nesting_crossing_count = 0;
 }
 
-/*** MODULE INTERFACE  ***************************************************************************/
+/* creates a new unlinked stitch vertex at the grid space point */
+static int
+add_stitch_vertex(struct isolines_context_t *ctx, struct point2d_t point)
+{
+  struct stitch_vertex_t *vertex;
 
-void
-init_isolines(struct point2d_t grid_pos_w_m)
+  assert(ctx->stitch_vertex_count < STITCH_VERTEX_MAX_COUNT);
+
+  vertex = &ctx->stitch_vertices[ctx->stitch_vertex_count];
+  vertex->point = point;
+  vertex->links[0] = vertex->links[1] = STITCH_LINK_NULL;
+  vertex->is_visited = false;
+
+  return ctx->stitch_vertex_count++;
+}
+
+static void
+link_stitch_vertex(struct isolines_context_t *ctx, int vertex_id, int other_vertex_id)
+{
+  struct stitch_vertex_t *vertex = &ctx->stitch_vertices[vertex_id];
+
+  if(vertex->links[0] == STITCH_LINK_NULL)
+    vertex->links[0] = other_vertex_id;
+  else
+  {
+    /* a vertex can only ever be shared by two segments */
+    assert(vertex->links[1] == STITCH_LINK_NULL);
+    vertex->links[1] = other_vertex_id;
+  }
+}
+
+static inline struct point2d_t
+get_polyline_vertex(struct isolines_context_t *ctx, int vertex)
 {
-  init_grid(grid_pos_w_m);
-  init_sample_gfx_data();
-  generate_glob_mesh();
-  generate_globs();
+  return (struct point2d_t){
+    ctx->isolines_polyline_mesh[(vertex * 2) + 0], 
+    ctx->isolines_polyline_mesh[(vertex * 2) + 1]
+  };
 }
 
-void
-tick_isolines(void)
+/* adds the segment p0 -> p1 of the polyline being built to its metrics sums */
+static inline void
+add_polyline_segment_metrics(struct isolines_context_t *ctx, struct point2d_t p0,
+                             struct point2d_t p1)
 {
-  tick_globs();
-  tick_grid();
+  float dx = p1.x - p0.x, dy = p1.y - p0.y, length = sqrtf((dx * dx) + (dy * dy));
 
-  reset_isolines_mesh();
+  ctx->polyline_metrics.length += length;
+  add_boundary_metrics(&ctx->polyline_metrics, p0, p1);
 
-  for(int i = 0; i < THRESHOLD_COUNT; ++i)
-    generate_isolines_mesh(thresholds[i]);
+  /* the length weighted sum of the segment midpoints; the centroid of an open polyline */
+  ctx->polyline_line_centroid_x += ((double)p0.x + p1.x) * 0.5 * length;
+  ctx->polyline_line_centroid_y += ((double)p0.y + p1.y) * 0.5 * length;
 }
 
-void
-draw_isolines(void)
+/* starts a new (empty) polyline; subsequent calls to 'push_polyline_vertex' append to it, and 
+ * 'end_polyline' completes it */
+static struct isoline_polyline_t *
+begin_polyline(struct isolines_context_t *ctx, bool is_closed)
 {
-  glPushMatrix();
-  glTranslatef(grid.pos_w_m.x, grid.pos_w_m.y, 0.f);
+  struct isoline_polyline_t *polyline;
 
-  draw_samples();
-  draw_isolines_mesh();
-  draw_globs();
+  ctx->isolines_polylines = xreserve(ctx->isolines_polylines, &ctx->isolines_polyline_capacity, 
+                                     ctx->isolines_polyline_count + 1, 
+                                     sizeof(struct isoline_polyline_t));
 
-  glPopMatrix();
+  polyline = &ctx->isolines_polylines[ctx->isolines_polyline_count++];
+  polyline->first_vertex = ctx->isolines_polyline_mesh_component_count >> 1;
+  polyline->vertex_count = 0;
+  polyline->is_closed = is_closed;
+  polyline->length = 0.f;
+  polyline->min = (struct point2d_t){INFINITY, INFINITY};
+  polyline->max = (struct point2d_t){-INFINITY, -INFINITY};
+  polyline->parent_threshold_id = polyline->parent_id = -1;
+  polyline->depth = 0;
+
+  reset_level_metrics(&ctx->polyline_metrics);
+
+  return polyline;
 }
 
+static void
+push_polyline_vertex(struct isolines_context_t *ctx, struct isoline_polyline_t *polyline,
+                     struct point2d_t point)
+{
+  struct point2d_t last;
+
+  /* the metrics are accumulated segment by segment as the polyline is built */
+  if(polyline->vertex_count > 0)
+  {
+    last.x = ctx->isolines_polyline_mesh[ctx->isolines_polyline_mesh_component_count - 2];
+    last.y = ctx->isolines_polyline_mesh[ctx->isolines_polyline_mesh_component_count - 1];
+    add_polyline_segment_metrics(ctx, last, point);
+  }
+
+  ctx->isolines_polyline_mesh = xreserve(ctx->isolines_polyline_mesh, 
+                                         &ctx->isolines_polyline_mesh_capacity,
+                                         ctx->isolines_polyline_mesh_component_count + 2, 
+                                         sizeof(GLfloat));
+
+  ctx->isolines_polyline_mesh[ctx->isolines_polyline_mesh_component_count++] = point.x;
+  ctx->isolines_polyline_mesh[ctx->isolines_polyline_mesh_component_count++] = point.y;
+  ++polyline->vertex_count;
+}
+
+/* completes the metrics of the polyline; closes the loop of a closed polyline */
+static void
+end_polyline(struct isolines_context_t *ctx, struct isoline_polyline_t *polyline)
+{
+  struct point2d_t first, last, point;
+  double area2;
+
+  if(polyline->is_closed && polyline->vertex_count > 1)
+  {
+    first = get_polyline_vertex(ctx, polyline->first_vertex);
+    last = get_polyline_vertex(ctx, polyline->first_vertex + polyline->vertex_count - 1);
+    add_polyline_segment_metrics(ctx, last, first);
+  }
+
+  for(int i = 0; i < polyline->vertex_count; i++)
+  {
+    point = get_polyline_vertex(ctx, polyline->first_vertex + i);
+    polyline->min.x = fminf(polyline->min.x, point.x);
+    polyline->min.y = fminf(polyline->min.y, point.y);
+    polyline->max.x = fmaxf(polyline->max.x, point.x);
+    polyline->max.y = fmaxf(polyline->max.y, point.y);
+  }
+
+  polyline->length = ctx->polyline_metrics.length;
+
+  /* the loops are not oriented so the area is unsigned */
+  area2 = polyline->is_closed ? ctx->polyline_metrics.area2 : 0.0;
+  polyline->area = fabs(area2) * 0.5;
+
+  if(area2 != 0.0)
+  {
+    polyline->centroid.x = ctx->polyline_metrics.centroid6_x / (3.0 * area2);
+    polyline->centroid.y = ctx->polyline_metrics.centroid6_y / (3.0 * area2);
+  }
+  else if(ctx->polyline_metrics.length > 0.0)
+  {
+    polyline->centroid.x = ctx->polyline_line_centroid_x / ctx->polyline_metrics.length;
+    polyline->centroid.y = ctx->polyline_line_centroid_y / ctx->polyline_metrics.length;
+  }
+  else
+    polyline->centroid = polyline->min;
+
+  ctx->polyline_line_centroid_x = ctx->polyline_line_centroid_y = 0.0;
+}
+
+/* records the crossing of the polyline being built (which must be closed) with the column of 
+ * samples through the edge its vertex 'point' lies on, for the nesting; vertices on horizontal
+ * edges are ignored */
+static void
+add_nesting_crossing(struct isolines_context_t *ctx, int edge, struct point2d_t point)
+{
+  if(edge >= TRACE_VERTICAL_EDGE_COUNT)
+    return;
+
+  ctx->nesting_crossings = xreserve(ctx->nesting_crossings, &ctx->nesting_crossing_capacity, 
+                                    ctx->nesting_crossing_count + 1, 
+                                    sizeof(struct nesting_crossing_t));
+  ctx->nesting_crossings[ctx->nesting_crossing_count++] = (struct nesting_crossing_t){
+    edge, point.y, ctx->isolines_polyline_count - 1
+  };
+}
+
+/* walks the chain of linked vertices starting at the vertex 'start_id', appending each vertex to
+ * the polyline mesh, and adds the resulting polyline to the polylines array. The start vertex 
+ * must be either an end of an open chain or any vertex of a closed chain. */
+static void
+add_stitch_polyline(struct isolines_context_t *ctx, int start_id, bool is_closed)
+{
+  struct stitch_vertex_t *vertex;
+  struct isoline_polyline_t *polyline;
+  int vertex_id, next_id;
+
+  polyline = begin_polyline(ctx, is_closed);
+
+  vertex_id = start_id;
+  while(vertex_id != STITCH_LINK_NULL)
+  {
+    vertex = &ctx->stitch_vertices[vertex_id];
+    vertex->is_visited = true;
+
+    push_polyline_vertex(ctx, polyline, vertex->point);
+    if(is_closed)
+      add_nesting_crossing(ctx, ctx->stitch_vertex_edges[vertex_id], vertex->point);
+
+    /* step to whichever link we did not arrive from; all vertices behind us are visited */
+    next_id = vertex->links[0];
+    if(next_id == STITCH_LINK_NULL || ctx->stitch_vertices[next_id].is_visited)
+      next_id = vertex->links[1];
+    if(next_id != STITCH_LINK_NULL && ctx->stitch_vertices[next_id].is_visited)
+      next_id = STITCH_LINK_NULL;
+
+    vertex_id = next_id;
+  }
+
+  end_polyline(ctx, polyline);
+}
+
+/* generates the isolines of a single threshold as a set of ordered polylines. Uses the same 
+ * column sweep as 'generate_isolines_mesh', but rather than emitting disconnected segments each
+ * generated point becomes a stitch vertex, shared with the neighbouring cell across the edge the
+ * point lies on (via the cell column cache, in the same way lerps are shared), and each segment
+ * links its two vertices. Once the sweep is complete the chains of linked vertices are walked to
+ * output the polylines; first the open chains (which start and end on the grid boundary), then 
+ * the closed chains (loops) from whatever vertices remain.
+ *
+ * every vertex is created once, linked at most twice and visited once, thus the stitching is 
+ * linear in the number of vertices. */
+static void
+generate_isolines_polylines(struct isolines_context_t *ctx, int threshold_id)
+{
+  float threshold = ctx->thresholds[threshold_id];
+  struct point2d_t point;
+  struct cell_t *current_cell, *bottom_cell, *left_cell;
+  struct sample_t samples[4];
+  struct cell_t *left_column_cache, *current_column_cache;
+  bool cell_column_cache_id = 0;
+  int8_t index;
+  int vertex_id, skip_rows;
+
+  ctx->stitch_vertex_count = 0;
+
+  left_column_cache = NULL;
+  current_column_cache = ctx->cell_column_cache[(int)cell_column_cache_id];
+
+  for(int col = 0; col < (SAMPLE_GRID_COL_COUNT - 1); col++)
+  {
+    for(int row = 0; row < (SAMPLE_GRID_ROW_COUNT - 1); row++)
+    {
+      /* skip the tiles and blocks no isoline of the threshold passes through */
+      skip_rows = get_pyramid_skip_rows(ctx, col, row, threshold);
+      if(skip_rows > 0)
+      {
+        row += skip_rows - 1;
+        continue;
+      }
+
+      samples[CELL_WEIGHT_BL].weight = ctx->grid.samples[col  ][row  ].weight;
+      samples[CELL_WEIGHT_BR].weight = ctx->grid.samples[col+1][row  ].weight;
+      samples[CELL_WEIGHT_TR].weight = ctx->grid.samples[col+1][row+1].weight;
+      samples[CELL_WEIGHT_TL].weight = ctx->grid.samples[col  ][row+1].weight;
+
+      current_cell = &current_column_cache[row];
+
+      compute_cell(samples, threshold, current_cell); 
+
+      bottom_cell = (row > 0) ? &current_column_cache[row - 1] : NULL;
+      left_cell = (left_column_cache != NULL) ? &left_column_cache[row] : NULL;
+
+      lerp_cell(threshold, current_cell, bottom_cell, left_cell);
+
+      for(int i = 0; i < 4; i++)
+      {
+        index = current_cell->indices[i];
+        if(index == CELL_POINT_NULL)
+          break;
+
+        /* the left and bottom points coincide with the right and top points of the cells to the
+         * left and below, which have already created vertices for them */
+        if(index == CELL_POINT_L && left_cell != NULL)
+          vertex_id = left_cell->vertex_ids[CELL_POINT_R];
+        else if(index == CELL_POINT_B && bottom_cell != NULL)
+          vertex_id = bottom_cell->vertex_ids[CELL_POINT_T];
+        else
+        {
+          point = current_cell->points[index];
+          point.x += col * CELL_SIZE_M;
+          point.y += row * CELL_SIZE_M;
+          vertex_id = add_stitch_vertex(ctx, point);
+          ctx->stitch_vertex_edges[vertex_id] = get_cell_edge(col, row, index);
+        }
+
+        current_cell->vertex_ids[index] = vertex_id;
+
+        /* indices come in pairs; each pair is a segment */
+        if(i % 2 == 1)
+        {
+          link_stitch_vertex(ctx, vertex_id,
+                             current_cell->vertex_ids[current_cell->indices[i - 1]]);
+          link_stitch_vertex(ctx, current_cell->vertex_ids[current_cell->indices[i - 1]],
+                             vertex_id);
+        }
+      }
+    }
+
+    left_column_cache = current_column_cache;
+    cell_column_cache_id = !cell_column_cache_id;
+    current_column_cache = ctx->cell_column_cache[(int)cell_column_cache_id];
+  }
+
+  ctx->isolines_polyline_threshold_offsets[threshold_id] = ctx->isolines_polyline_count;
+
+  /* every vertex is written once, and every polyline has at least two vertices, so the buffers 
+   * can be sized up front */
+  ctx->isolines_polyline_mesh = xreserve(ctx->isolines_polyline_mesh,
+                                         &ctx->isolines_polyline_mesh_capacity,
+                                         ctx->isolines_polyline_mesh_component_count + 
+                                           (ctx->stitch_vertex_count * 2),
+                                         sizeof(GLfloat));
+  ctx->isolines_polylines = xreserve(ctx->isolines_polylines, &ctx->isolines_polyline_capacity, 
+                                     ctx->isolines_polyline_count + (ctx->stitch_vertex_count / 2), 
+                                     sizeof(struct isoline_polyline_t));
+
+  /* open polylines; a vertex with a single link is an end */
+  for(int i = 0; i < ctx->stitch_vertex_count; i++)
+    if(!ctx->stitch_vertices[i].is_visited && ctx->stitch_vertices[i].links[1] == STITCH_LINK_NULL)
+      add_stitch_polyline(ctx, i, false);
+
+  /* closed polylines; every unvisited vertex is now part of a loop */
+  for(int i = 0; i < ctx->stitch_vertex_count; i++)
+    if(!ctx->stitch_vertices[i].is_visited)
+      add_stitch_polyline(ctx, i, true);
+
+  ctx->isolines_polyline_threshold_offsets[threshold_id + 1] = ctx->isolines_polyline_count;
+}
+
+/* the weight of a sample evaluated on demand; each sample is evaluated at most once per tick. The
+ * sample color is updated along with the weight, so only samples visited by the tracer have 
+ * up to date colors. */
+static float
+get_lazy_sample_weight(struct isolines_context_t *ctx, int col, int row)
+{
+  struct sample_t *sample = &ctx->grid.samples[col][row];
+  float r, g, b;
+
+  if(ctx->sample_stamps[col][row] != ctx->tick_stamp)
+  {
+    sample->weight = calculate_sample_weights_sum(ctx, get_sample_vertex(ctx, col, row));
+    weight_to_color(sample->weight, &r, &g, &b);
+    set_sample_color(ctx, col, row, r, g, b);
+    ctx->sample_stamps[col][row] = ctx->tick_stamp;
+  }
+
+  return sample->weight;
+}
+
+/* the two samples at the ends of an edge, (col0, row0) is always the bottom/left sample */
+static bool
+get_edge_samples(int edge, int *col0, int *row0, int *col1, int *row1)
+{
+  bool is_vertical = edge < TRACE_VERTICAL_EDGE_COUNT;
+
+  if(is_vertical)
+  {
+    *col0 = *col1 = edge / (SAMPLE_GRID_ROW_COUNT - 1);
+    *row0 = edge % (SAMPLE_GRID_ROW_COUNT - 1);
+    *row1 = *row0 + 1;
+  }
+  else
+  {
+    edge -= TRACE_VERTICAL_EDGE_COUNT;
+    *col0 = edge / SAMPLE_GRID_ROW_COUNT;
+    *row0 = *row1 = edge % SAMPLE_GRID_ROW_COUNT;
+    *col1 = *col0 + 1;
+  }
+
+  return is_vertical;
+}
+
+/* the (one or two) cells which share an edge, and the side of each cell the edge lies on; returns
+ * the number of cells */
+static int
+get_edge_cells(int edge, int cols[2], int rows[2], int8_t sides[2])
+{
+  int col0, row0, col1, row1, count = 0;
+
+  if(get_edge_samples(edge, &col0, &row0, &col1, &row1))
+  {
+    if(col0 < (SAMPLE_GRID_COL_COUNT - 1))
+    {
+      cols[count] = col0; rows[count] = row0; sides[count++] = CELL_POINT_L;
+    }
+    if(col0 > 0)
+    {
+      cols[count] = col0 - 1; rows[count] = row0; sides[count++] = CELL_POINT_R;
+    }
+  }
+  else
+  {
+    if(row0 < (SAMPLE_GRID_ROW_COUNT - 1))
+    {
+      cols[count] = col0; rows[count] = row0; sides[count++] = CELL_POINT_B;
+    }
+    if(row0 > 0)
+    {
+      cols[count] = col0; rows[count] = row0 - 1; sides[count++] = CELL_POINT_T;
+    }
+  }
+
+  return count;
+}
+
+static bool
+is_edge_crossed(struct isolines_context_t *ctx, int edge, float threshold)
+{
+  int col0, row0, col1, row1;
+
+  get_edge_samples(edge, &col0, &row0, &col1, &row1);
+
+  return (get_lazy_sample_weight(ctx, col0, row0) >= threshold) != 
+         (get_lazy_sample_weight(ctx, col1, row1) >= threshold);
+}
+
+/* the grid space point at which the isoline crosses the edge; lerped as in 'lerp_cell' */
+static struct point2d_t
+get_edge_point(struct isolines_context_t *ctx, int edge, float threshold)
+{
+  int col0, row0, col1, row1;
+  struct point2d_t point;
+  float offset;
+
+  bool is_vertical = get_edge_samples(edge, &col0, &row0, &col1, &row1);
+
+  offset = lerp(threshold, 
+                get_lazy_sample_weight(ctx, col0, row0), 
+                get_lazy_sample_weight(ctx, col1, row1),
+                CELL_SIZE_M);
+
+  point.x = col0 * CELL_SIZE_M;
+  point.y = row0 * CELL_SIZE_M;
+
+  if(is_vertical)
+    point.y += offset;
+  else
+    point.x += offset;
+
+  return point;
+}
+
+static uint8_t
+get_lazy_cell_state_mask(struct isolines_context_t *ctx, int col, int row, float threshold)
+{
+  uint8_t state_mask = 0;
+
+  if(get_lazy_sample_weight(ctx, col    , row    ) >= threshold) SET_CORNER(0b0001, state_mask);
+  if(get_lazy_sample_weight(ctx, col + 1, row    ) >= threshold) SET_CORNER(0b0010, state_mask);
+  if(get_lazy_sample_weight(ctx, col + 1, row + 1) >= threshold) SET_CORNER(0b0100, state_mask);
+  if(get_lazy_sample_weight(ctx, col    , row + 1) >= threshold) SET_CORNER(0b1000, state_mask);
+
+  return state_mask;
+}
+
+/* the side through which a contour entering a cell through 'entry_side' leaves the cell; the 
+ * pairs of indices in the lookup table are the segments of the cell */
+static int8_t
+get_exit_side(uint8_t state_mask, int8_t entry_side)
+{
+  const int8_t *indices = cell_lookup[state_mask];
+
+  for(int i = 0; i < 4; i += 2)
+  {
+    if(indices[i] == entry_side)
+      return indices[i + 1];
+    if(indices[i + 1] == entry_side)
+      return indices[i];
+  }
+
+  /* the entry edge must be crossed by the contour */
+  assert(0);
+  return CELL_POINT_NULL;
+}
+
+/* walks a contour from cell to cell, starting by entering the cell (col, row) through the side 
+ * 'entry_side', appending the edges crossed to 'edges' and marking them as traced. The walk ends
+ * when the contour leaves the grid (returns false) or arrives back at the edge 'start_edge' 
+ * (returns true; the contour is closed). */
+static bool
+walk_contour(struct isolines_context_t *ctx, float threshold, int col, int row, int8_t entry_side,
+             int start_edge, 
+             int *edges, int *edge_count)
+{
+  int8_t exit_side;
+  int edge;
+
+  *edge_count = 0;
+
+  while(true)
+  {
+    exit_side = get_exit_side(get_lazy_cell_state_mask(ctx, col, row, threshold), entry_side);
+    edge = get_cell_edge(col, row, exit_side);
+
+    if(edge == start_edge)
+      return true;
+
+    /* every edge belongs to exactly one contour */
+    assert(ctx->edge_trace_stamps[edge] != ctx->trace_stamp);
+
+    ctx->edge_trace_stamps[edge] = ctx->trace_stamp;
+    edges[(*edge_count)++] = edge;
+
+    switch(exit_side)
+    {
+    case CELL_POINT_L: --col; break;
+    case CELL_POINT_B: --row; break;
+    case CELL_POINT_R: ++col; break;
+    case CELL_POINT_T: ++row; break;
+    }
+
+    if(col < 0 || col >= (SAMPLE_GRID_COL_COUNT - 1) || row < 0 || row >= (SAMPLE_GRID_ROW_COUNT - 1))
+      return false;
+
+    /* the exit side of one cell is the opposite side of the next cell; L<->R and B<->T */
+    entry_side = (exit_side + 2) % 4;
+  }
+}
+
+/* traces the whole contour which crosses the edge 'start_edge' and adds it as a polyline. The 
+ * contour is first walked forwards from the edge; if it does not loop back it must be open, in
+ * which case it is also walked backwards from the edge, and the backwards walk reversed and 
+ * prepended to the forwards walk. */
+static void
+trace_contour(struct isolines_context_t *ctx, int threshold_id, int start_edge)
+{
+  float threshold = ctx->thresholds[threshold_id];
+  struct isoline_polyline_t *polyline;
+  int cols[2], rows[2];
+  int8_t sides[2];
+  int cell_count, forward_count, backward_count = 0;
+  bool is_closed;
+
+  cell_count = get_edge_cells(start_edge, cols, rows, sides);
+
+  ctx->edge_trace_stamps[start_edge] = ctx->trace_stamp;
+
+  is_closed = walk_contour(ctx, threshold, cols[0], rows[0], sides[0], start_edge, 
+                           ctx->trace_forward_edges, &forward_count);
+
+  if(!is_closed && cell_count == 2)
+    walk_contour(ctx, threshold, cols[1], rows[1], sides[1], start_edge, 
+                 ctx->trace_backward_edges, &backward_count);
+
+  polyline = begin_polyline(ctx, is_closed);
+
+  for(int i = backward_count - 1; i >= 0; i--)
+    push_polyline_vertex(ctx, polyline, 
+                         get_edge_point(ctx, ctx->trace_backward_edges[i], threshold));
+
+  push_polyline_vertex(ctx, polyline, get_edge_point(ctx, start_edge, threshold));
+
+  for(int i = 0; i < forward_count; i++)
+    push_polyline_vertex(ctx, polyline, 
+                         get_edge_point(ctx, ctx->trace_forward_edges[i], threshold));
+
+  end_polyline(ctx, polyline);
+
+  /* a closed contour has no backwards walk */
+  if(is_closed)
+  {
+    add_nesting_crossing(ctx, start_edge, get_polyline_vertex(ctx, polyline->first_vertex));
+    for(int i = 0; i < forward_count; i++)
+      add_nesting_crossing(ctx, ctx->trace_forward_edges[i], 
+                           get_polyline_vertex(ctx, polyline->first_vertex + 1 + i));
+  }
+
+  ctx->trace_seeds = xreserve(ctx->trace_seeds, &ctx->trace_seed_capacity, 
+                              ctx->trace_seed_count + 1, sizeof(struct trace_seed_t));
+  ctx->trace_seeds[ctx->trace_seed_count++] = (struct trace_seed_t){start_edge, threshold_id};
+}
+
+static void
+try_trace_contour(struct isolines_context_t *ctx, int threshold_id, int edge)
+{
+  if(ctx->edge_trace_stamps[edge] != ctx->trace_stamp && 
+     is_edge_crossed(ctx, edge, ctx->thresholds[threshold_id]))
+    trace_contour(ctx, threshold_id, edge);
+}
+
+/* generates the isolines of a single threshold by tracing each contour from a seed edge, touching
+ * only the cells the contours pass through. Seeds come from:
+ *
+ *  1. the edges on the grid boundary; every open contour starts and ends on the boundary.
+ *
+ *  2. the edges near the seeds of the contours traced in the previous tick; contours move only a
+ *     fraction of a cell per tick, so are very likely to still cross the same (or an adjacent) 
+ *     edge.
+ *
+ *  3. rays cast along the sample row through each glob center (in the +x direction). The weight
+ *     function is subharmonic (away from the glob centers), thus every closed contour around a
+ *     region of high weight encloses at least one glob center; the ray from that center must 
+ *     cross the contour. The ray is cast until the weight falls below the lowest threshold.
+ *
+ * note - a closed contour around a region of low weight (a hole between merged globs) is found
+ *   only if it is crossed by a glob ray or was traced in the previous tick.
+ */
+static void
+trace_isolines(struct isolines_context_t *ctx, int threshold_id)
+{
+  struct globber_t *glob;
+  int cols[2], rows[2];
+  int8_t sides[2];
+  int cell_count, col, row;
+
+  ++ctx->trace_stamp;
+
+  ctx->isolines_polyline_threshold_offsets[threshold_id] = ctx->isolines_polyline_count;
+
+  for(row = 0; row < (SAMPLE_GRID_ROW_COUNT - 1); row++)
+  {
+    try_trace_contour(ctx, threshold_id, get_vertical_edge(0, row));
+    try_trace_contour(ctx, threshold_id, get_vertical_edge(SAMPLE_GRID_COL_COUNT - 1, row));
+  }
+  for(col = 0; col < (SAMPLE_GRID_COL_COUNT - 1); col++)
+  {
+    try_trace_contour(ctx, threshold_id, get_horizontal_edge(col, 0));
+    try_trace_contour(ctx, threshold_id, get_horizontal_edge(col, SAMPLE_GRID_ROW_COUNT - 1));
+  }
+
+  for(int i = 0; i < ctx->prev_trace_seed_count; i++)
+  {
+    if(ctx->prev_trace_seeds[i].threshold_id != threshold_id)
+      continue;
+
+    cell_count = get_edge_cells(ctx->prev_trace_seeds[i].edge, cols, rows, sides);
+    for(int j = 0; j < cell_count; j++)
+      for(int8_t side = CELL_POINT_L; side <= CELL_POINT_T; side++)
+        try_trace_contour(ctx, threshold_id, get_cell_edge(cols[j], rows[j], side));
+  }
+
+  for(int i = 0; i < GLOB_COUNT; i++)
+  {
+    glob = &ctx->globbers[i];
+
+    col = (int)(glob->center_g_m.x / CELL_SIZE_M);
+    row = (int)((glob->center_g_m.y / CELL_SIZE_M) + 0.5f);
+    col = (col < 0) ? 0 : (col > SAMPLE_GRID_COL_COUNT - 2) ? SAMPLE_GRID_COL_COUNT - 2 : col;
+    row = (row < 0) ? 0 : (row > SAMPLE_GRID_ROW_COUNT - 1) ? SAMPLE_GRID_ROW_COUNT - 1 : row;
+
+    for(; col < (SAMPLE_GRID_COL_COUNT - 1); col++)
+    {
+      try_trace_contour(ctx, threshold_id, get_horizontal_edge(col, row));
+
+      /* the thresholds are in ascending order */
+      if(get_lazy_sample_weight(ctx, col + 1, row) < ctx->thresholds[0])
+        break;
+    }
+  }
+
+  ctx->isolines_polyline_threshold_offsets[threshold_id + 1] = ctx->isolines_polyline_count;
+}
+
+/*** NESTING *************************************************************************************/
+
+/* the threshold of a polyline, by its index into the polylines of all thresholds */
+static int
+get_polyline_threshold(struct isolines_context_t *ctx, int polyline)
+{
+  int threshold_id = 0;
+
+  while(polyline >= ctx->isolines_polyline_threshold_offsets[threshold_id + 1])
+    ++threshold_id;
+
+  return threshold_id;
+}
+
+/* sorts the crossings by edge (a counting sort), then the crossings of each edge by y (an 
+ * insertion sort; an edge is crossed at most once per threshold) */
+static void
+sort_nesting_crossings(struct isolines_context_t *ctx)
+{
+  struct nesting_crossing_t *crossings = ctx->nesting_crossings, crossing;
+  struct nesting_crossing_t *sorted;
+  int *offsets = ctx->nesting_edge_offsets, count = 0, j;
+
+  ctx->sorted_nesting_crossings = xreserve(ctx->sorted_nesting_crossings, 
+                                           &ctx->sorted_nesting_crossing_capacity,
+                                           ctx->nesting_crossing_count, 
+                                           sizeof(struct nesting_crossing_t));
+  sorted = ctx->sorted_nesting_crossings;
+
+  memset((void *)offsets, 0, sizeof(int) * (TRACE_VERTICAL_EDGE_COUNT + 1));
+  for(int i = 0; i < ctx->nesting_crossing_count; i++)
+    ++offsets[crossings[i].edge];
+
+  for(int i = 0; i <= TRACE_VERTICAL_EDGE_COUNT; i++)
+  {
+    j = offsets[i];
+    offsets[i] = count;
+    count += j;
+  }
+
+  /* the offsets are advanced as the crossings are placed, to the start of the next edge */
+  for(int i = 0; i < ctx->nesting_crossing_count; i++)
+    sorted[offsets[crossings[i].edge]++] = crossings[i];
+  for(int i = TRACE_VERTICAL_EDGE_COUNT; i > 0; i--)
+    offsets[i] = offsets[i - 1];
+  offsets[0] = 0;
+
+  for(int edge = 0; edge < TRACE_VERTICAL_EDGE_COUNT; edge++)
+  {
+    for(int i = offsets[edge] + 1; i < offsets[edge + 1]; i++)
+    {
+      crossing = sorted[i];
+      for(j = i; j > offsets[edge] && sorted[j - 1].y > crossing.y; j--)
+        sorted[j] = sorted[j - 1];
+      sorted[j] = crossing;
+    }
+  }
+}
+
+/* nests the closed polylines of all thresholds (see the NESTING section of the declarations); 
+ * once every threshold has been extracted */
+static void
+nest_isolines_polylines(struct isolines_context_t *ctx)
+{
+  const struct nesting_crossing_t *crossing;
+  struct isoline_polyline_t *polyline;
+  int stack_count = 0, col = -1, parent, parent_threshold_id;
+
+  sort_nesting_crossings(ctx);
+
+  /* the stack holds at most every crossing */
+  ctx->nesting_stack = xreserve(ctx->nesting_stack, &ctx->nesting_stack_capacity, 
+                                ctx->nesting_crossing_count, sizeof(int));
+
+  for(int i = 0; i < ctx->nesting_crossing_count; i++)
+  {
+    crossing = &ctx->sorted_nesting_crossings[i];
+
+    /* each column of samples is swept from the bottom of the grid, outside of every polyline */
+    if(crossing->edge / (SAMPLE_GRID_ROW_COUNT - 1) != col)
+    {
+      col = crossing->edge / (SAMPLE_GRID_ROW_COUNT - 1);
+      stack_count = 0;
+    }
+
+    if(stack_count > 0 && ctx->nesting_stack[stack_count - 1] == crossing->polyline)
+    {
+      --stack_count;
+      continue;
+    }
+
+    /* the polyline is entered; it may be entered again (in this column or another), always 
+     * with the same parent */
+    polyline = &ctx->isolines_polylines[crossing->polyline];
+    if(stack_count > 0)
+    {
+      parent = ctx->nesting_stack[stack_count - 1];
+      parent_threshold_id = get_polyline_threshold(ctx, parent);
+      polyline->parent_threshold_id = parent_threshold_id;
+      polyline->parent_id = parent - ctx->isolines_polyline_threshold_offsets[parent_threshold_id];
+    }
+    polyline->depth = stack_count;
+
+    ctx->nesting_stack[stack_count++] = crossing->polyline;
+  }
+}
+
+/*** ADAPTIVE ************************************************************************************/
+
+/* bounds the weights of the field over the rectangle [min, max] (grid space); the weight 
+ * contributed by a glob falls with the distance from its centre, so lies between its weights at 
+ * the farthest and nearest points of the rectangle. The upper bound is infinite if the rectangle
+ * holds the centre of a glob. */
+static struct weight_range_t
+get_field_bounds(struct isolines_context_t *ctx, struct point2d_t min, struct point2d_t max)
+{
+  struct weight_range_t range = {0.f, 0.f};
+  struct point2d_t center;
+  float near_dx, near_dy, far_dx, far_dy, near_d2, radius2;
+
+  for(int i = 0; i < GLOB_COUNT; i++)
+  {
+    center = ctx->globbers[i].center_g_m;
+    radius2 = ctx->globbers[i].radius_m * ctx->globbers[i].radius_m;
+
+    near_dx = fmaxf(fmaxf(min.x - center.x, center.x - max.x), 0.f);
+    near_dy = fmaxf(fmaxf(min.y - center.y, center.y - max.y), 0.f);
+    far_dx = fmaxf(center.x - min.x, max.x - center.x);
+    far_dy = fmaxf(center.y - min.y, max.y - center.y);
+
+    near_d2 = (near_dx * near_dx) + (near_dy * near_dy);
+    range.min += radius2 / ((far_dx * far_dx) + (far_dy * far_dy));
+    range.max += (near_d2 > 0.f) ? radius2 / near_d2 : INFINITY;
+  }
+
+  range.min *= (1.f - ADAPTIVE_BOUND_MARGIN);
+  range.max *= (1.f + ADAPTIVE_BOUND_MARGIN);
+
+  return range;
+}
+
+/* refines the node of 'size' cells with its bottom-left cell at (col, row); 'threshold_mask' is
+ * the mask of thresholds which may cross the parent node. The cells of the node which may be 
+ * crossed are appended to the leaves. */
+static void
+refine_adaptive_node(struct isolines_context_t *ctx, int col, int row, int size,
+                     uint32_t threshold_mask)
+{
+  struct weight_range_t range;
+  int col1, row1, half;
+
+  col1 = col + size;
+  row1 = row + size;
+  col1 = (col1 < SAMPLE_GRID_COL_COUNT - 1) ? col1 : SAMPLE_GRID_COL_COUNT - 1;
+  row1 = (row1 < SAMPLE_GRID_ROW_COUNT - 1) ? row1 : SAMPLE_GRID_ROW_COUNT - 1;
+
+  range = get_field_bounds(ctx, (struct point2d_t){col * CELL_SIZE_M, row * CELL_SIZE_M},
+                           (struct point2d_t){col1 * CELL_SIZE_M, row1 * CELL_SIZE_M});
+
+  for(int i = 0; i < THRESHOLD_COUNT; i++)
+    if(!is_range_crossed(range, ctx->thresholds[i]))
+      threshold_mask &= ~(1u << i);
+
+  if(threshold_mask == 0)
+    return;
+
+  if(size == 1)
+  {
+    assert(ctx->adaptive_leaf_count < ADAPTIVE_LEAF_MAX_COUNT);
+    ctx->adaptive_leaves[ctx->adaptive_leaf_count++] = 
+      (struct adaptive_leaf_t){col, row, threshold_mask};
+    return;
+  }
+
+  half = size / 2;
+  for(int child_col = col; child_col < col1; child_col += half)
+    for(int child_row = row; child_row < row1; child_row += half)
+      refine_adaptive_node(ctx, child_col, child_row, half, threshold_mask);
+}
+
+/* generates the isolines mesh of every threshold from the leaves of the quadtree; the segments of
+ * a leaf are found as the tracer finds them, from the lazily evaluated samples of its edges. */
+static void
+generate_isolines_mesh_adaptive(struct isolines_context_t *ctx)
+{
+  struct adaptive_leaf_t *leaf;
+  struct point2d_t p0, p1;
+  const int8_t *indices;
+  uint8_t state_mask;
+
+  ctx->adaptive_leaf_count = 0;
+  for(int col = 0; col < SAMPLE_GRID_COL_COUNT - 1; col += ADAPTIVE_ROOT_SIZE)
+    for(int row = 0; row < SAMPLE_GRID_ROW_COUNT - 1; row += ADAPTIVE_ROOT_SIZE)
+      refine_adaptive_node(ctx, col, row, ADAPTIVE_ROOT_SIZE, (1u << THRESHOLD_COUNT) - 1);
+
+  for(int i = 0; i < THRESHOLD_COUNT; i++)
+  {
+    begin_isolines_mesh_level(ctx, i);
+
+    for(int j = 0; j < ctx->adaptive_leaf_count; j++)
+    {
+      leaf = &ctx->adaptive_leaves[j];
+      if(!(leaf->threshold_mask & (1u << i)))
+        continue;
+
+      state_mask = get_lazy_cell_state_mask(ctx, leaf->col, leaf->row, ctx->thresholds[i]);
+      indices = cell_lookup[state_mask];
+      for(int k = 0; k < 4 && indices[k] != CELL_POINT_NULL; k += 2)
+      {
+        p0 = get_edge_point(ctx, get_cell_edge(leaf->col, leaf->row, indices[k]),
+                            ctx->thresholds[i]);
+        p1 = get_edge_point(ctx, get_cell_edge(leaf->col, leaf->row, indices[k + 1]),
+                            ctx->thresholds[i]);
+        push_mesh_chunk_point(ctx, &ctx->isolines_mesh, p0);
+        push_mesh_chunk_point(ctx, &ctx->isolines_mesh, p1);
+        add_segment_metrics(ctx->isolines_mesh.metrics, p0, p1, state_mask, indices[k]);
+      }
+    }
+  }
+
+  /* the metrics close the regions of each level along the border of the grid from the border 
+   * samples */
+  for(int col = 0; col < SAMPLE_GRID_COL_COUNT; col++)
+  {
+    get_lazy_sample_weight(ctx, col, 0);
+    get_lazy_sample_weight(ctx, col, SAMPLE_GRID_ROW_COUNT - 1);
+  }
+  for(int row = 1; row < SAMPLE_GRID_ROW_COUNT - 1; row++)
+  {
+    get_lazy_sample_weight(ctx, 0, row);
+    get_lazy_sample_weight(ctx, SAMPLE_GRID_COL_COUNT - 1, row);
+  }
+}
+
+/*** SIMPLIFICATION ******************************************************************************/
+
+/* the square of the distance of p from the line through a and b (or from a if a = b) */
+static inline float
+get_line_distance_squared(struct point2d_t p, struct point2d_t a, struct point2d_t b)
+{
+  float dx = b.x - a.x, dy = b.y - a.y, cross, length_squared;
+
+  length_squared = (dx * dx) + (dy * dy);
+  if(length_squared == 0.f)
+    return ((p.x - a.x) * (p.x - a.x)) + ((p.y - a.y) * (p.y - a.y));
+
+  cross = (dx * (p.y - a.y)) - (dy * (p.x - a.x));
+  return (cross * cross) / length_squared;
+}
+
+/* marks the vertices to keep of the span [first, last] of a polyline of 'count' vertices starting
+ * at vertex 'base'; the span may run past the end of a closed polyline, back to its start. The 
+ * ends of the span are always kept. Douglas-Peucker, with an explicit stack rather than recursion
+ * since isolines can be long. */
+static void
+simplify_polyline_span(struct isolines_context_t *ctx, int base, int count, int first, int last,
+                       struct simplify_scratch_t *scratch)
+{
+  static const float tolerance_squared = ISOLINES_SIMPLIFY_TOLERANCE_M * ISOLINES_SIMPLIFY_TOLERANCE_M;
+
+  struct point2d_t a, b;
+  float distance_squared, max_distance_squared;
+  int stack_count = 0, farthest;
+
+  scratch->is_kept[first % count] = scratch->is_kept[last % count] = true;
+
+  scratch->stack = xreserve(scratch->stack, &scratch->stack_capacity, 2, sizeof(int));
+  scratch->stack[stack_count++] = first;
+  scratch->stack[stack_count++] = last;
+
+  while(stack_count > 0)
+  {
+    last = scratch->stack[--stack_count];
+    first = scratch->stack[--stack_count];
+
+    a = get_polyline_vertex(ctx, base + (first % count));
+    b = get_polyline_vertex(ctx, base + (last % count));
+
+    farthest = -1;
+    max_distance_squared = tolerance_squared;
+    for(int i = first + 1; i < last; i++)
+    {
+      distance_squared = get_line_distance_squared(get_polyline_vertex(ctx, base + (i % count)), 
+                                                   a, b);
+      if(distance_squared > max_distance_squared)
+      {
+        max_distance_squared = distance_squared;
+        farthest = i;
+      }
+    }
+
+    /* every vertex of the span is within tolerance of the line, so all are dropped */
+    if(farthest < 0)
+      continue;
+
+    scratch->is_kept[farthest % count] = true;
+
+    scratch->stack = xreserve(scratch->stack, &scratch->stack_capacity, stack_count + 4, sizeof(int));
+    scratch->stack[stack_count++] = first;
+    scratch->stack[stack_count++] = farthest;
+    scratch->stack[stack_count++] = farthest;
+    scratch->stack[stack_count++] = last;
+  }
+}
+
+/* simplifies a polyline in place; the kept vertices are packed at the start of its vertices, so 
+ * the polylines stay independent of each other. A closed polyline is split in two at its first
+ * vertex and the vertex farthest from it, and each half simplified as an open polyline. */
+static void
+simplify_polyline(struct isolines_context_t *ctx, struct isoline_polyline_t *polyline,
+                  struct simplify_scratch_t *scratch)
+{
+  struct point2d_t first;
+  float distance_squared, max_distance_squared = -1.f;
+  int base = polyline->first_vertex, count = polyline->vertex_count, kept_count = 0, farthest = 0;
+  GLfloat *vertices = ctx->isolines_polyline_mesh;
+
+  if(count <= (polyline->is_closed ? 3 : 2))
+    return;
+
+  scratch->is_kept = xreserve(scratch->is_kept, &scratch->is_kept_capacity, count, sizeof(bool));
+  memset((void *)scratch->is_kept, 0, sizeof(bool) * count);
+
+  if(polyline->is_closed)
+  {
+    first = get_polyline_vertex(ctx, base);
+    for(int i = 1; i < count; i++)
+    {
+      distance_squared = get_line_distance_squared(get_polyline_vertex(ctx, base + i), 
+                                                   first, first);
+      if(distance_squared > max_distance_squared)
+      {
+        max_distance_squared = distance_squared;
+        farthest = i;
+      }
+    }
+
+    /* the second half runs on around the loop back to the first vertex */
+    simplify_polyline_span(ctx, base, count, 0, farthest, scratch);
+    simplify_polyline_span(ctx, base, count, farthest, count, scratch);
+  }
+  else
+    simplify_polyline_span(ctx, base, count, 0, count - 1, scratch);
+
+  for(int i = 0; i < count; i++)
+    kept_count += scratch->is_kept[i];
+
+  /* a loop within tolerance of a line is kept whole rather than collapsed */
+  if(polyline->is_closed && kept_count < 3)
+    return;
+
+  kept_count = 0;
+  for(int i = 0; i < count; i++)
+  {
+    if(!scratch->is_kept[i])
+      continue;
+    vertices[((base + kept_count) * 2) + 0] = vertices[((base + i) * 2) + 0];
+    vertices[((base + kept_count) * 2) + 1] = vertices[((base + i) * 2) + 1];
+    ++kept_count;
+  }
+
+  polyline->vertex_count = kept_count;
+}
+
+/* simplifies a range of the polylines of the threshold given by the args */
+static void
+run_simplify_job(void *args, int job_id, int thread_id)
+{
+  struct isolines_context_t *ctx = ((struct simplify_job_args_t *)args)->ctx;
+  int threshold_id = ((struct simplify_job_args_t *)args)->threshold_id;
+  int first = ctx->isolines_polyline_threshold_offsets[threshold_id];
+  int count = ctx->isolines_polyline_threshold_offsets[threshold_id + 1] - first;
+
+  for(int i = first + ((count * job_id) / ISOLINES_SIMPLIFY_JOB_COUNT); 
+      i < first + ((count * (job_id + 1)) / ISOLINES_SIMPLIFY_JOB_COUNT); 
+      i++)
+  {
+    simplify_polyline(ctx, &ctx->isolines_polylines[i], &ctx->simplify_scratches[thread_id]);
+  }
+}
+
+/* simplifies the polylines of a threshold on the thread pool, once they have been extracted. Each
+ * threshold is simplified as soon as it is extracted, while its vertices are still in the cache, 
+ * rather than in a separate pass over all the polylines. */
+static void
+simplify_isolines_polylines(struct isolines_context_t *ctx, int threshold_id)
+{
+  struct simplify_job_args_t args = {ctx, threshold_id};
+
+  pool_run(&ctx->isolines_pool, run_simplify_job, &args, ISOLINES_SIMPLIFY_JOB_COUNT);
+}
+
+/* starts a new tick of tracing; the seeds of the last tick become the previous seeds */
+static void
+begin_trace_isolines(struct isolines_context_t *ctx)
+{
+  struct trace_seed_t *seeds = ctx->prev_trace_seeds;
+  int seed_capacity = ctx->prev_trace_seed_capacity;
+
+  ctx->prev_trace_seeds = ctx->trace_seeds;
+  ctx->prev_trace_seed_capacity = ctx->trace_seed_capacity;
+  ctx->prev_trace_seed_count = ctx->trace_seed_count;
+  ctx->trace_seeds = seeds;
+  ctx->trace_seed_capacity = seed_capacity;
+  ctx->trace_seed_count = 0;
+}
+
+/*** BANDS ***************************************************************************************/
+
+/* the lower and upper bound of the weights of a band */
+static inline float
+get_band_lower_bound(struct isolines_context_t *ctx, int band_id)
+{
+  return ctx->thresholds[band_id];
+}
+
+static inline float
+get_band_upper_bound(struct isolines_context_t *ctx, int band_id)
+{
+  return (band_id + 1 < BAND_COUNT) ? ctx->thresholds[band_id + 1] : INFINITY;
+}
+
+static inline void
+reset_isobands(struct isolines_context_t *ctx)
+{
+  ctx->isoband_vertex_count = 0;
+  for(int i = 0; i < BAND_COUNT; i++)
+    ctx->isoband_index_counts[i] = 0;
+}
+
+/* returns the id of the vertex in the slot, adding the vertex (at the point) if the slot is empty */
+static int
+get_band_vertex(struct isolines_context_t *ctx, int *slot, struct point2d_t point)
+{
+  if(*slot == BAND_VERTEX_NULL)
+  {
+    ctx->isoband_vertices = xreserve(ctx->isoband_vertices, &ctx->isoband_vertex_capacity, 
+                                     (ctx->isoband_vertex_count + 1) * 2, sizeof(GLfloat));
+    ctx->isoband_vertices[(ctx->isoband_vertex_count * 2) + 0] = point.x;
+    ctx->isoband_vertices[(ctx->isoband_vertex_count * 2) + 1] = point.y;
+    *slot = ctx->isoband_vertex_count++;
+  }
+
+  return *slot;
+}
+
+/* the vertex where the threshold crosses the edge from p0 to p1; the point is lerped from p0, so
+ * callers must always pass the ends of an edge in the same order for the edge to be lerped the
+ * same way from every cell and triangle which shares it */
+static int
+get_band_edge_vertex(struct isolines_context_t *ctx, int *slot, float threshold,
+                     struct point2d_t p0, float w0, struct point2d_t p1, 
+                     float w1)
+{
+  struct point2d_t point;
+  float t;
+
+  if(*slot != BAND_VERTEX_NULL)
+    return *slot;
+
+  t = (threshold - w0) / (w1 - w0);
+  point.x = p0.x + ((p1.x - p0.x) * t);
+  point.y = p0.y + ((p1.y - p0.y) * t);
+
+  return get_band_vertex(ctx, slot, point);
+}
+
+/* appends the triangles of the convex polygon (as vertex ids) to the band, as a fan */
+static void
+push_band_polygon(struct isolines_context_t *ctx, int band_id, const int *polygon, int vertex_count)
+{
+  int *count = &ctx->isoband_index_counts[band_id];
+
+  ctx->isoband_indices[band_id] = xreserve(ctx->isoband_indices[band_id],
+                                           &ctx->isoband_index_capacities[band_id],
+                                           *count + ((vertex_count - 2) * 3), sizeof(GLuint));
+
+  for(int i = 1; i < vertex_count - 1; i++)
+  {
+    ctx->isoband_indices[band_id][(*count)++] = polygon[0];
+    ctx->isoband_indices[band_id][(*count)++] = polygon[i];
+    ctx->isoband_indices[band_id][(*count)++] = polygon[i + 1];
+  }
+}
+
+/* the band a weight is in; -1 if below all bands */
+static inline int
+get_weight_band(struct isolines_context_t *ctx, float weight)
+{
+  int band_id = -1;
+
+  while(band_id + 1 < BAND_COUNT && weight >= ctx->thresholds[band_id + 1])
+    ++band_id;
+
+  return band_id;
+}
+
+/* a vertex of a triangle of a cell being split into bands */
+struct band_corner_t
+{
+  struct point2d_t point;
+  float weight;
+  int *slot;
+};
+
+/* an edge of a triangle of a cell being split into bands; runs between the triangle's corner and
+ * the next (anticlockwise), but is lerped from corner 'first' to 'last' (see 
+ * 'get_band_edge_vertex'). The slots hold the vertex ids of the points on the edge per threshold. */
+struct band_edge_t
+{
+  int *slots;
+  int first;
+  int last;
+};
+
+/* generates the triangles of all bands in a triangle of a cell */
+static void
+generate_isobands_triangle(struct isolines_context_t *ctx, struct band_corner_t corners[3],
+                           struct band_edge_t edges[3])
+{
+  float lower, upper;
+  int8_t states[3];
+  int polygon[5], vertex_count, next, bounds[2], bound_count, min_band, max_band, band_id;
+  struct band_corner_t *first, *last;
+
+  min_band = max_band = get_weight_band(ctx, corners[0].weight);
+  for(int i = 1; i < 3; i++)
+  {
+    band_id = get_weight_band(ctx, corners[i].weight);
+    min_band = (band_id < min_band) ? band_id : min_band;
+    max_band = (band_id > max_band) ? band_id : max_band;
+  }
+
+  for(band_id = (min_band > 0) ? min_band : 0; band_id <= max_band; band_id++)
+  {
+    lower = get_band_lower_bound(ctx, band_id);
+    upper = get_band_upper_bound(ctx, band_id);
+
+    for(int i = 0; i < 3; i++)
+      states[i] = (corners[i].weight < lower) ? 0 : ((corners[i].weight < upper) ? 1 : 2);
+
+    vertex_count = 0;
+    for(int i = 0; i < 3; i++)
+    {
+      next = (i + 1) % 3;
+
+      if(states[i] == 1)
+        polygon[vertex_count++] = get_band_vertex(ctx, corners[i].slot, corners[i].point);
+
+      if(states[i] == states[next])
+        continue;
+
+      /* the bounds crossed along the edge, in the order they are crossed walking from the corner
+       * to the next */
+      bound_count = 0;
+      if(states[i] < states[next])
+      {
+        if(states[i] == 0) bounds[bound_count++] = band_id;
+        if(states[next] == 2) bounds[bound_count++] = band_id + 1;
+      }
+      else
+      {
+        if(states[i] == 2) bounds[bound_count++] = band_id + 1;
+        if(states[next] == 0) bounds[bound_count++] = band_id;
+      }
+
+      first = &corners[edges[i].first];
+      last = &corners[edges[i].last];
+      for(int j = 0; j < bound_count; j++)
+      {
+        polygon[vertex_count++] = get_band_edge_vertex(ctx, &edges[i].slots[bounds[j]], 
+                                                       ctx->thresholds[bounds[j]],
+                                                       first->point, first->weight,
+                                                       last->point, last->weight);
+      }
+    }
+
+    assert(vertex_count <= 5);
+    if(vertex_count >= 3)
+      push_band_polygon(ctx, band_id, polygon, vertex_count);
+  }
+}
+
+/* generates the triangles of all bands for the cell (col, row); 'left' and 'right' select the 
+ * sample columns of the caches on the left and right of the cell */
+static void
+generate_isobands_cell(struct isolines_context_t *ctx, int col, int row, int left, int right)
+{
+  /* the corners and edges of the cell in anticlockwise order from BL; edge i runs from corner i
+   * to the next. Edges 0 and 1 are lerped from their start (their left or bottom sample) and edges
+   * 2 and 3 from their end, so every edge is lerped the same way from both of its cells. */
+  const int corner_cols[4] = {col, col + 1, col + 1, col};
+  const int corner_rows[4] = {row, row, row + 1, row + 1};
+  int *corner_slots[4] = {
+    &ctx->band_corner_ids[left][row], &ctx->band_corner_ids[right][row], 
+    &ctx->band_corner_ids[right][row + 1], &ctx->band_corner_ids[left][row + 1]
+  };
+  int *edge_slots[4] = {
+    ctx->band_horizontal_edge_ids[row], ctx->band_vertical_edge_ids[right][row], 
+    ctx->band_horizontal_edge_ids[row + 1], ctx->band_vertical_edge_ids[left][row]
+  };
+
+  struct band_corner_t cell_corners[4], center, triangle[3];
+  struct band_edge_t edges[3];
+  int polygon[4], band_id;
+  bool is_one_band = true;
+
+  center.point = (struct point2d_t){(col + 0.5f) * CELL_SIZE_M, (row + 0.5f) * CELL_SIZE_M};
+  center.weight = 0.f;
+  center.slot = &ctx->band_center_id;
+
+  for(int i = 0; i < 4; i++)
+  {
+    cell_corners[i].point = (struct point2d_t){corner_cols[i] * CELL_SIZE_M, 
+                                               corner_rows[i] * CELL_SIZE_M};
+    cell_corners[i].weight = ctx->grid.samples[corner_cols[i]][corner_rows[i]].weight;
+    cell_corners[i].slot = corner_slots[i];
+    center.weight += cell_corners[i].weight * 0.25f;
+  }
+
+  band_id = get_weight_band(ctx, cell_corners[0].weight);
+  for(int i = 1; i < 4; i++)
+    is_one_band &= (get_weight_band(ctx, cell_corners[i].weight) == band_id);
+
+  /* the whole cell is in one band (or below all bands) */
+  if(is_one_band)
+  {
+    if(band_id >= 0)
+    {
+      for(int i = 0; i < 4; i++)
+        polygon[i] = get_band_vertex(ctx, cell_corners[i].slot, cell_corners[i].point);
+      push_band_polygon(ctx, band_id, polygon, 4);
+    }
+    return;
+  }
+
+  ctx->band_center_id = BAND_VERTEX_NULL;
+  memset(ctx->band_diagonal_ids, BAND_VERTEX_NULL, sizeof(ctx->band_diagonal_ids));
+
+  /* the triangles {corner i, corner i+1, centre}; the diagonals are lerped from the centre */
+  for(int i = 0; i < 4; i++)
+  {
+    triangle[0] = cell_corners[i];
+    triangle[1] = cell_corners[(i + 1) % 4];
+    triangle[2] = center;
+
+    edges[0] = (struct band_edge_t){edge_slots[i], (i < 2) ? 0 : 1, (i < 2) ? 1 : 0};
+    edges[1] = (struct band_edge_t){ctx->band_diagonal_ids[(i + 1) % 4], 2, 1};
+    edges[2] = (struct band_edge_t){ctx->band_diagonal_ids[i], 2, 0};
+
+    generate_isobands_triangle(ctx, triangle, edges);
+  }
+}
+
+/* generates the triangles of all bands in a single sweep of the grid, column by column as the 
+ * isolines mesh is generated; the vertices shared with the previous column and the cell below are
+ * found in the caches, so every vertex is computed (and stored) once. */
+static void
+generate_isobands(struct isolines_context_t *ctx)
+{
+  bool left = 0, right = 1; /* bools used to easily flip between 0 and 1 */
+
+  memset(ctx->band_corner_ids[left], BAND_VERTEX_NULL, sizeof(ctx->band_corner_ids[left]));
+  memset(ctx->band_vertical_edge_ids[left], BAND_VERTEX_NULL,
+         sizeof(ctx->band_vertical_edge_ids[left]));
+
+  for(int col = 0; col < SAMPLE_GRID_COL_COUNT - 1; col++)
+  {
+    memset(ctx->band_corner_ids[right], BAND_VERTEX_NULL, sizeof(ctx->band_corner_ids[right]));
+    memset(ctx->band_vertical_edge_ids[right], BAND_VERTEX_NULL,
+           sizeof(ctx->band_vertical_edge_ids[right]));
+    memset(ctx->band_horizontal_edge_ids, BAND_VERTEX_NULL, sizeof(ctx->band_horizontal_edge_ids));
+
+    for(int row = 0; row < SAMPLE_GRID_ROW_COUNT - 1; row++)
+      generate_isobands_cell(ctx, col, row, left, right);
+
+    /* the right side of this column is the left side of the next */
+    left = !left;
+    right = !right;
+  }
+}
+
+/* the grid space point at which the isoline crosses the edge between the samples (col0, row0) and
+ * (col1, row1) of a lattice; always lerped from the bottom/left sample, so the cells on either 
+ * side of the edge find the same point */
+static struct point2d_t
+get_lattice_edge_point(struct isolines_context_t *ctx, int col0, int row0, int col1, int row1,
+                       float threshold)
+{
+  float w0 = ctx->grid.samples[col0][row0].weight;
+  float w1 = ctx->grid.samples[col1][row1].weight;
+  float offset = (threshold - w0) / (w1 - w0);
+
+  return (struct point2d_t){
+    (col0 * CELL_SIZE_M) + ((col1 - col0) * CELL_SIZE_M * offset),
+    (row0 * CELL_SIZE_M) + ((row1 - row0) * CELL_SIZE_M * offset)
+  };
+}
+
+/* the point at which the isoline crosses the side 'side' (CELL_POINT_*) of the lattice cell 
+ * [col0, col1] x [row0, row1] */
+static struct point2d_t
+get_lattice_cell_point(struct isolines_context_t *ctx, int col0, int row0, int col1, int row1,
+                       int8_t side, float threshold)
+{
+  switch(side)
+  {
+  case CELL_POINT_L:
+    return get_lattice_edge_point(ctx, col0, row0, col0, row1, threshold);
+  case CELL_POINT_B:
+    return get_lattice_edge_point(ctx, col0, row0, col1, row0, threshold);
+  case CELL_POINT_R:
+    return get_lattice_edge_point(ctx, col1, row0, col1, row1, threshold);
+  case CELL_POINT_T:
+    return get_lattice_edge_point(ctx, col0, row1, col1, row1, threshold);
+  }
+  assert(0);
+  return (struct point2d_t){0.f, 0.f};
+}
+
+/* generates a vertex mesh from the cells of the region of the sample grid, or (for a 'stride' 
+ * above 1) from the lattice of every 'stride' samples of the grid, over the region; only the 
+ * samples of the lattice are read, and the region must be aligned to the lattice. The cells of 
+ * the lattice on the top and right of the grid are cut short by the border of the grid.
+ *
+ *    +-------+-------+---+         a lattice of stride 2 over a grid of 6x6 samples; the cells
+ *    |       |       |   |         share their edges (and edge points) with their neighbours
+ *    +-------+-------+---+         just as the cells of the grid do.
+ *    |       |       |   |
+ *    |       |       |   |
+ *    +-------+-------+---+
+ *    |       |       |   |
+ *    |       |       |   |
+ *    o-------+-------+---+
+ */
+static void
+generate_isolines_mesh(struct isolines_context_t *ctx, float threshold, int stride,
+                       const struct cell_region_t *region)
+{
+  struct point2d_t p0, p1;
+  const int8_t *indices;
+  uint8_t state_mask;
+  int col1, row1;
+
+  if(stride == 1)
+  {
+    generate_isolines_mesh_region(ctx, threshold, region->col0, region->row0, region->col1, 
+                                  region->row1, ctx->cell_column_cache, &ctx->isolines_mesh);
+    return;
+  }
+
+  for(int col0 = region->col0; col0 < region->col1; col0 = col1)
+  {
+    col1 = get_next_lattice_index(col0, stride, SAMPLE_GRID_COL_COUNT);
+
+    for(int row0 = region->row0; row0 < region->row1; row0 = row1)
+    {
+      row1 = get_next_lattice_index(row0, stride, SAMPLE_GRID_ROW_COUNT);
+
+      state_mask = 0;
+      if(ctx->grid.samples[col0][row0].weight >= threshold) SET_CORNER(0b0001, state_mask);
+      if(ctx->grid.samples[col1][row0].weight >= threshold) SET_CORNER(0b0010, state_mask);
+      if(ctx->grid.samples[col1][row1].weight >= threshold) SET_CORNER(0b0100, state_mask);
+      if(ctx->grid.samples[col0][row1].weight >= threshold) SET_CORNER(0b1000, state_mask);
+
+      indices = cell_lookup[state_mask];
+      for(int i = 0; i < 4 && indices[i] != CELL_POINT_NULL; i += 2)
+      {
+        p0 = get_lattice_cell_point(ctx, col0, row0, col1, row1, indices[i], threshold);
+        p1 = get_lattice_cell_point(ctx, col0, row0, col1, row1, indices[i + 1], threshold);
+        push_mesh_chunk_point(ctx, &ctx->isolines_mesh, p0);
+        push_mesh_chunk_point(ctx, &ctx->isolines_mesh, p1);
+        if(ctx->isolines_mesh.metrics != NULL)
+          add_segment_metrics(ctx->isolines_mesh.metrics, p0, p1, state_mask, indices[i]);
+      }
+    }
+  }
+}
+
+/* the number of segments generated by each case of the lookup table */
+static const int8_t cell_segment_counts[16] = {0, 1, 1, 1, 1, 2, 1, 1, 1, 1, 2, 1, 1, 1, 1, 0};
+
+/* counts the segments that 'generate_isolines_mesh_region' would generate from the same region;
+ * uses only the case index of each cell, so no lerps are performed and nothing is written. Tiles
+ * are skipped with the pyramid, exactly as in the extraction. */
+static int
+count_isolines_segments_region(struct isolines_context_t *ctx, float threshold, int col0, int row0,
+                               int col1, int row1)
+{
+  uint8_t state_mask;
+  int segment_count = 0, skip_rows;
+
+  for(int col = col0; col < col1; col++)
+  {
+    for(int row = row0; row < row1; row++)
+    {
+      skip_rows = get_pyramid_skip_rows(ctx, col, row, threshold);
+      if(skip_rows > 0)
+      {
+        row += skip_rows - 1;
+        continue;
+      }
+
+      state_mask = 0;
+      if(ctx->grid.samples[col  ][row  ].weight >= threshold) SET_CORNER(0b0001, state_mask);
+      if(ctx->grid.samples[col+1][row  ].weight >= threshold) SET_CORNER(0b0010, state_mask);
+      if(ctx->grid.samples[col+1][row+1].weight >= threshold) SET_CORNER(0b0100, state_mask);
+      if(ctx->grid.samples[col  ][row+1].weight >= threshold) SET_CORNER(0b1000, state_mask);
+
+      segment_count += cell_segment_counts[state_mask];
+    }
+  }
+
+  return segment_count;
+}
+
+/* the threshold and the cells of a job of the parallel extraction; the cells extracted this tick
+ * are split into strips of columns */
+static int
+get_job_region(struct isolines_context_t *ctx, int job_id, struct cell_region_t *region)
+{
+  const struct cell_region_t *cells = &ctx->isolines_mesh_region;
+  int strip_width = ((cells->col1 - cells->col0) + ISOLINES_STRIP_COUNT - 1) / 
+                    ISOLINES_STRIP_COUNT;
+  int strip = job_id % ISOLINES_STRIP_COUNT;
+
+  *region = *cells;
+  region->col0 = cells->col0 + (strip * strip_width);
+  region->col1 = region->col0 + strip_width;
+  region->col0 = (region->col0 < cells->col1) ? region->col0 : cells->col1;
+  region->col1 = (region->col1 < cells->col1) ? region->col1 : cells->col1;
+
+  return job_id / ISOLINES_STRIP_COUNT;
+}
+
+/* first pass; counts the segments of one strip of columns for one threshold */
+static void
+run_count_job(void *args, int job_id, int thread_id)
+{
+  struct isolines_context_t *ctx = args;
+  struct cell_region_t region;
+  int threshold_id;
+
+  threshold_id = get_job_region(ctx, job_id, &region);
+
+  ctx->job_segment_counts[job_id] = count_isolines_segments_region(ctx, 
+                                                                   ctx->thresholds[threshold_id], 
+                                                                   region.col0, region.row0, 
+                                                                   region.col1, region.row1);
+}
+
+/* second pass; extracts one strip of columns for one threshold directly into its place in the 
+ * isolines mesh */
+static void
+run_fill_job(void *args, int job_id, int thread_id)
+{
+  struct isolines_context_t *ctx = args;
+  struct mesh_chunk_t chunk;
+  struct cell_region_t region;
+  int threshold_id;
+
+  threshold_id = get_job_region(ctx, job_id, &region);
+
+  chunk.components = &ctx->isolines_mesh.components[ctx->job_offsets[job_id]];
+  chunk.component_count = 0;
+  chunk.capacity = ctx->job_segment_counts[job_id] * 4;
+  chunk.growth = MESH_CHUNK_FIXED;
+  chunk.slab_mesh = NULL;
+  chunk.metrics = &ctx->job_level_metrics[job_id];
+  reset_level_metrics(chunk.metrics);
+
+  generate_isolines_mesh_region(ctx, ctx->thresholds[threshold_id], region.col0, region.row0, 
+                                region.col1, region.row1, ctx->thread_column_caches[thread_id], 
+                                &chunk);
+
+  /* the count must be exact or the jobs' outputs would overlap or leave gaps */
+  assert(chunk.component_count == chunk.capacity);
+}
+
+/* generates the isolines mesh of all thresholds on the thread pool, in two passes. The grid is 
+ * split into strips of columns and each (threshold, strip) pair is a separate job.
+ *
+ *  1. count: each job counts the segments it will generate from the case indices of its cells 
+ *     alone, which is far cheaper than the extraction itself.
+ *
+ *  2. fill: an exclusive prefix sum over the counts gives the offset of each job's output in the
+ *     mesh and the exact size of the mesh; the mesh is grown to fit (if needed) and each job 
+ *     then extracts its strip directly into its place in the mesh.
+ *
+ * The serial extraction emits the thresholds in order, and each threshold column by column, so
+ * placing the outputs in job order reproduces the serial mesh exactly.
+ *
+ *     strip: 0     1     2     3              mesh: [t0s0|t0s1|t0s2|t0s3|t1s0|t1s1|...]
+ *          +-----+-----+-----+-----+
+ *          |     |     |     |     |          where:
+ *          | s0  | s1  | s2  | s3  |             tNsM = output of threshold N, strip M
+ *          |     |     |     |     |
+ *          +-----+-----+-----+-----+
+ */
+static void
+generate_isolines_mesh_parallel(struct isolines_context_t *ctx)
+{
+  int component_count = 0;
+
+  pool_run(&ctx->isolines_pool, run_count_job, ctx, ISOLINES_JOB_COUNT);
+
+  for(int i = 0; i < ISOLINES_JOB_COUNT; i++)
+  {
+    ctx->job_offsets[i] = component_count;
+    component_count += ctx->job_segment_counts[i] * 4;
+  }
+
+  /* the jobs are ordered by threshold so the offset of a level is that of its first strip */
+  for(int i = 0; i < THRESHOLD_COUNT; i++)
+    ctx->isolines_mesh_level_offsets[i] = ctx->job_offsets[i * ISOLINES_STRIP_COUNT];
+
+  ctx->isolines_mesh.components = xreserve(ctx->isolines_mesh.components,
+                                           &ctx->isolines_mesh.capacity, 
+                                           component_count, sizeof(GLfloat));
+
+  pool_run(&ctx->isolines_pool, run_fill_job, ctx, ISOLINES_JOB_COUNT);
+
+  ctx->isolines_mesh.component_count = component_count;
+
+  /* merged in job order, so the sums are the same every run */
+  for(int i = 0; i < ISOLINES_JOB_COUNT; i++)
+    merge_level_metrics(&ctx->isolines_level_metrics[i / ISOLINES_STRIP_COUNT],
+                        &ctx->job_level_metrics[i]);
+}
+
+/* extracts one strip of columns for one threshold into the job's own slab mesh */
+static void
+run_slab_extraction_job(void *args, int job_id, int thread_id)
+{
+  struct isolines_context_t *ctx = args;
+  struct mesh_chunk_t chunk;
+  struct cell_region_t region;
+  int threshold_id;
+
+  threshold_id = get_job_region(ctx, job_id, &region);
+
+  open_slab_mesh_chunk(&ctx->job_slab_meshes[job_id], &chunk);
+  chunk.metrics = &ctx->job_level_metrics[job_id];
+  reset_level_metrics(chunk.metrics);
+
+  generate_isolines_mesh_region(ctx, ctx->thresholds[threshold_id], region.col0, region.row0,
+                                region.col1, 
+                                region.row1, ctx->thread_column_caches[thread_id], &chunk);
+
+  close_slab_mesh_chunk(&chunk);
+}
+
+/* generates the isolines mesh of all thresholds on the thread pool, in slabs. Every job extracts
+ * its strip, in a single pass, into slabs of its own; the slab lists are then linked together in
+ * job order. As with 'generate_isolines_mesh_parallel' the result is the same as the serial mesh,
+ * only split differently between slabs, and no components are copied. */
+static void
+generate_isolines_mesh_parallel_slabs(struct isolines_context_t *ctx)
+{
+  pool_run(&ctx->isolines_pool, run_slab_extraction_job, ctx, ISOLINES_JOB_COUNT);
+
+  for(int i = 0; i < ISOLINES_JOB_COUNT; i++)
+  {
+    if(i % ISOLINES_STRIP_COUNT == 0)
+      begin_isolines_mesh_level(ctx, i / ISOLINES_STRIP_COUNT);
+    append_slab_mesh(&ctx->isolines_mesh_slabs, &ctx->job_slab_meshes[i]);
+    merge_level_metrics(&ctx->isolines_level_metrics[i / ISOLINES_STRIP_COUNT],
+                        &ctx->job_level_metrics[i]);
+  }
+}
+
+static inline struct weight_range_t
+get_span_tile_range(struct isolines_context_t *ctx, int tile)
+{
+  return ctx->pyramid_tiles[tile / PYRAMID_TILE_ROW_COUNT][tile % PYRAMID_TILE_ROW_COUNT];
+}
+
+static int
+compare_tile_sort_entries(const void *a, const void *b)
+{
+  float key_a = ((const struct tile_sort_entry_t *)a)->key;
+  float key_b = ((const struct tile_sort_entry_t *)b)->key;
+  return (key_a > key_b) - (key_a < key_b);
+}
+
+/* sorts the 'count' entries in ascending order of key and writes their tiles, in that order, to
+ * the 'tiles' array */
+static void
+sort_tiles(struct tile_sort_entry_t *entries, int *tiles, int count)
+{
+  qsort(entries, count, sizeof(struct tile_sort_entry_t), compare_tile_sort_entries);
+  for(int i = 0; i < count; i++)
+    tiles[i] = entries[i].tile;
+}
+
+/* builds the subtree of the span space index over the 'count' tiles in the array 'tiles'; the
+ * tiles array is reordered in the process. The center of the node is the min of the median tile 
+ * (by min) so the node always stores at least the median tile, and each subtree has at most half
+ * of the tiles; the tree is balanced. Returns the root of the subtree. */
+static int
+build_span_node(struct isolines_context_t *ctx, int *tiles, int count)
+{
+  struct span_node_t *node;
+  struct weight_range_t range;
+  int node_id, tile, left_count = 0, right_count = 0, center_count = 0;
+
+  if(count == 0)
+    return SPAN_NODE_NULL;
+
+  for(int i = 0; i < count; i++)
+    ctx->tile_sort_entries[i] = 
+      (struct tile_sort_entry_t){get_span_tile_range(ctx, tiles[i]).min, tiles[i]};
+  sort_tiles(ctx->tile_sort_entries, tiles, count);
+
+  node_id = ctx->span_node_count++;
+  node = &ctx->span_nodes[node_id];
+  node->center = get_span_tile_range(ctx, tiles[count / 2]).min;
+
+  /* partition the tiles into {left, right, center}; partitioning is stable so each partition is
+   * still sorted by min */
+  for(int i = 0; i < count; i++)
+    if(get_span_tile_range(ctx, tiles[i]).max < node->center)
+      ctx->span_build_scratch[left_count++] = tiles[i];
+  for(int i = 0; i < count; i++)
+    if(get_span_tile_range(ctx, tiles[i]).min > node->center)
+      ctx->span_build_scratch[left_count + right_count++] = tiles[i];
+  for(int i = 0; i < count; i++)
+  {
+    range = get_span_tile_range(ctx, tiles[i]);
+    if(range.min <= node->center && node->center <= range.max)
+      ctx->span_build_scratch[left_count + right_count + center_count++] = tiles[i];
+  }
+  memcpy(tiles, ctx->span_build_scratch, sizeof(int) * count);
+
+  /* the node's tiles are stored in the same position of both arrays; the position of the tiles
+   * in the build array is unique to the node so makes for a convenient choice */
+  node->first = (tiles - ctx->span_build_tiles) + left_count + right_count;
+  node->count = center_count;
+  memcpy(&ctx->span_tiles_by_min[node->first], &tiles[left_count + right_count],
+         sizeof(int) * center_count);
+
+  /* sorted in ascending order of -max, i.e. descending order of max */
+  for(int i = 0; i < center_count; i++)
+  {
+    tile = tiles[left_count + right_count + i];
+    ctx->tile_sort_entries[i] = 
+      (struct tile_sort_entry_t){-get_span_tile_range(ctx, tile).max, tile};
+  }
+  sort_tiles(ctx->tile_sort_entries, &ctx->span_tiles_by_max[node->first], center_count);
+
+  node->left = build_span_node(ctx, tiles, left_count);
+  node->right = build_span_node(ctx, tiles + left_count, right_count);
+
+  /* the node pointer may not be used after recursion; it is still valid though since the nodes
+   * array is static */
+  return node_id;
+}
+
+/* builds the span space index from the current pyramid tiles */
+static void
+build_span_index(struct isolines_context_t *ctx)
+{
+  for(int i = 0; i < SPAN_TILE_COUNT; i++)
+    ctx->span_build_tiles[i] = i;
+
+  ctx->span_node_count = 0;
+  ctx->span_root = build_span_node(ctx, ctx->span_build_tiles, SPAN_TILE_COUNT);
+}
+
+/* finds all tiles which an isoline of the threshold may pass through, i.e. the tiles whose range
+ * straddles the threshold (see 'is_range_crossed'); the tiles are written to 'span_query_tiles'.
+ * Returns the number of tiles found.
+ *
+ * the query descends a single path of the tree. At each node, if the threshold is at or below the
+ * center, all the node's tiles have a max >= threshold, so those with a min < threshold are 
+ * reported (a prefix of the tiles ordered by min) and the search continues left; the tiles to the
+ * right have min > center >= threshold so cannot straddle it. Symmetrically if the threshold is 
+ * above the center. The cost is thus O(log(n) + k) for n tiles and k reported tiles. */
+static int
+query_span_index(struct isolines_context_t *ctx, float threshold)
+{
+  struct span_node_t *node;
+  int node_id = ctx->span_root, count = 0, tile;
+
+  while(node_id != SPAN_NODE_NULL)
+  {
+    node = &ctx->span_nodes[node_id];
+
+    if(threshold <= node->center)
+    {
+      for(int i = node->first; i < node->first + node->count; i++)
+      {
+        tile = ctx->span_tiles_by_min[i];
+        if(get_span_tile_range(ctx, tile).min >= threshold)
+          break;
+        ctx->span_query_tiles[count++] = tile;
+      }
+      node_id = node->left;
+    }
+    else
+    {
+      for(int i = node->first; i < node->first + node->count; i++)
+      {
+        tile = ctx->span_tiles_by_max[i];
+        if(get_span_tile_range(ctx, tile).max < threshold)
+          break;
+        ctx->span_query_tiles[count++] = tile;
+      }
+      node_id = node->right;
+    }
+  }
+
+  return count;
+}
+
+/* generates a vertex mesh only from the tiles which the span space index reports the isoline of
+ * the threshold passes through; the field must be frozen (so the index is valid). */
+static void
+generate_isolines_mesh_from_span_index(struct isolines_context_t *ctx, float threshold)
+{
+  int tile_count, tile_col, tile_row, col0, row0, col1, row1;
+
+  assert(ctx->is_field_frozen);
+
+  tile_count = query_span_index(ctx, threshold);
+
+  for(int i = 0; i < tile_count; i++)
+  {
+    tile_col = ctx->span_query_tiles[i] / PYRAMID_TILE_ROW_COUNT;
+    tile_row = ctx->span_query_tiles[i] % PYRAMID_TILE_ROW_COUNT;
+
+    get_tile_region(tile_col, tile_row, &col0, &row0, &col1, &row1);
+
+    generate_isolines_mesh_region(ctx, threshold, col0, row0, col1, row1, ctx->cell_column_cache,
+                                  &ctx->isolines_mesh);
+  }
+}
+
+/* true if the samples of the tile have changed enough since the tile was last extracted for its
+ * mesh to need re-extracting; see ISOLINES_REMESH_EPSILON */
+static bool
+is_tile_dirty(struct isolines_context_t *ctx, int tile_col, int tile_row)
+{
+  float old_weight, new_weight;
+  bool is_drifted = false;
+  int col0, row0, col1, row1;
+
+  get_tile_region(tile_col, tile_row, &col0, &row0, &col1, &row1);
+
+  for(int col = col0; col <= col1; col++)
+  {
+    for(int row = row0; row <= row1; row++)
+    {
+      old_weight = ctx->tile_extracted_weights[tile_col][tile_row][col - col0][row - row0];
+      new_weight = ctx->grid.samples[col][row].weight;
+
+      /* a sample crossing a threshold changes the case of its cells */
+      for(int i = 0; i < THRESHOLD_COUNT; i++)
+        if((old_weight >= ctx->thresholds[i]) != (new_weight >= ctx->thresholds[i]))
+          return true;
+
+      is_drifted |= fabsf(new_weight - old_weight) > ISOLINES_REMESH_EPSILON;
+    }
+  }
+
+  /* no sample crossed a threshold so if no threshold crosses the tile now, none crossed it when 
+   * it was extracted either; its mesh is empty and stays empty however far the samples drift */
+  if(is_drifted)
+  {
+    for(int i = 0; i < THRESHOLD_COUNT; i++)
+      if(is_range_crossed(ctx->pyramid_tiles[tile_col][tile_row], ctx->thresholds[i]))
+        return true;
+  }
+
+  return false;
+}
+
+/* replaces the mesh of a tile with a fresh extraction of all thresholds from the current samples,
+ * and records the samples it was extracted from */
+static void
+remesh_tile(struct isolines_context_t *ctx, int tile_col, int tile_row,
+            struct cell_t (*column_cache)[SAMPLE_GRID_ROW_COUNT])
+{
+  struct mesh_chunk_t *mesh = &ctx->tile_meshes[tile_col][tile_row];
+  int col0, row0, col1, row1;
+
+  get_tile_region(tile_col, tile_row, &col0, &row0, &col1, &row1);
+
+  mesh->component_count = 0;
+  for(int i = 0; i < THRESHOLD_COUNT; i++)
+  {
+    ctx->tile_mesh_level_offsets[tile_col][tile_row][i] = mesh->component_count;
+    mesh->metrics = &ctx->tile_level_metrics[tile_col][tile_row][i];
+    reset_level_metrics(mesh->metrics);
+    generate_isolines_mesh_region(ctx, ctx->thresholds[i], col0, row0, col1, row1, column_cache,
+                                  mesh);
+  }
+  ctx->tile_mesh_level_offsets[tile_col][tile_row][THRESHOLD_COUNT] = mesh->component_count;
+  mesh->metrics = NULL;
+
+  for(int col = col0; col <= col1; col++)
+    for(int row = row0; row <= row1; row++)
+      ctx->tile_extracted_weights[tile_col][tile_row][col - col0][row - row0] = 
+        ctx->grid.samples[col][row].weight;
+}
+
+/* re-extracts the dirty tile at index (first dirty tile + job id) of the dirty tiles */
+static void
+run_remesh_job(void *args, int job_id, int thread_id)
+{
+  struct isolines_context_t *ctx = args;
+  int tile = ctx->dirty_tiles[ctx->remeshed_tile_count + job_id];
+  int tile_col = tile / PYRAMID_TILE_ROW_COUNT;
+  int tile_row = tile % PYRAMID_TILE_ROW_COUNT;
+
+  remesh_tile(ctx, tile_col, tile_row, ctx->thread_column_caches[thread_id]);
+  ctx->stale_tiles[tile_col][tile_row] = false;
+  ctx->tile_wait_ticks[tile_col][tile_row] = 0;
+}
+
+/* the priority of a dirty tile; lower is sooner. The distance of the tile from the focus (unit:
+ * tiles) less the ticks it has waited, so a tile gains a tile of proximity each tick it waits. */
+static float
+get_dirty_tile_priority(struct isolines_context_t *ctx, int tile_col, int tile_row)
+{
+  static const float tile_size_m = PYRAMID_TILE_SIZE * CELL_SIZE_M;
+
+  float dx = ((tile_col + 0.5f) * tile_size_m) - ctx->remesh_focus_g_m.x;
+  float dy = ((tile_row + 0.5f) * tile_size_m) - ctx->remesh_focus_g_m.y;
+
+  return (sqrtf(dx * dx + dy * dy) / tile_size_m) - ctx->tile_wait_ticks[tile_col][tile_row];
+}
+
+/* true once the work budget of the tick (see ISOLINES_REMESH_BUDGET_S) is spent */
+static bool
+is_remesh_budget_spent(struct isolines_context_t *ctx)
+{
+  if(ISOLINES_REMESH_BUDGET_TILES > 0 && ctx->remeshed_tile_count >= ISOLINES_REMESH_BUDGET_TILES)
+    return true;
+
+  if(ISOLINES_REMESH_BUDGET_S > 0 && clock_time_s(&ctx->remesh_clock) >= ISOLINES_REMESH_BUDGET_S)
+    return true;
+
+  return false;
+}
+
+/* brings the tile meshes up to date with the samples, re-extracting only the dirty tiles; in a 
+ * slowly changing field only the few tiles the isolines are moving through are re-extracted. The 
+ * tile meshes are independent so the dirty tiles are re-extracted on the thread pool.
+ *
+ * the dirty tiles are re-extracted in order of priority, in batches of one tile per thread, until
+ * the work budget of the tick is spent; the rest wait for a later tick.
+ *
+ * the mesh of a tile is extracted from the region of its cells alone (lerping all of its points,
+ * as do the strips of the parallel extraction), thus is the same whichever tiles are dirty. */
+static void
+remesh_isolines_incremental(struct isolines_context_t *ctx)
+{
+  int tile, batch_tile_count;
+
+  clock_reset(&ctx->remesh_clock);
+
+  ctx->dirty_tile_count = 0;
+  for(int tile_col = 0; tile_col < PYRAMID_TILE_COL_COUNT; tile_col++)
+  {
+    for(int tile_row = 0; tile_row < PYRAMID_TILE_ROW_COUNT; tile_row++)
+    {
+      if(ctx->stale_tiles[tile_col][tile_row] || is_tile_dirty(ctx, tile_col, tile_row))
+      {
+        tile = tile_col * PYRAMID_TILE_ROW_COUNT + tile_row;
+        ctx->tile_sort_entries[ctx->dirty_tile_count++] = 
+          (struct tile_sort_entry_t){get_dirty_tile_priority(ctx, tile_col, tile_row), tile};
+      }
+    }
+  }
+
+  sort_tiles(ctx->tile_sort_entries, ctx->dirty_tiles, ctx->dirty_tile_count);
+
+  ctx->remeshed_tile_count = 0;
+  while(ctx->remeshed_tile_count < ctx->dirty_tile_count && !is_remesh_budget_spent(ctx))
+  {
+    batch_tile_count = ctx->dirty_tile_count - ctx->remeshed_tile_count;
+    if(batch_tile_count > ISOLINES_THREAD_COUNT)
+      batch_tile_count = ISOLINES_THREAD_COUNT;
+    if(ISOLINES_REMESH_BUDGET_TILES > 0 && 
+       batch_tile_count > ISOLINES_REMESH_BUDGET_TILES - ctx->remeshed_tile_count)
+      batch_tile_count = ISOLINES_REMESH_BUDGET_TILES - ctx->remeshed_tile_count;
+
+    pool_run(&ctx->isolines_pool, run_remesh_job, ctx, batch_tile_count);
+    ctx->remeshed_tile_count += batch_tile_count;
+  }
+
+  for(int i = ctx->remeshed_tile_count; i < ctx->dirty_tile_count; i++)
+    ++ctx->tile_wait_ticks[ctx->dirty_tiles[i] / PYRAMID_TILE_ROW_COUNT]
+                          [ctx->dirty_tiles[i] % PYRAMID_TILE_ROW_COUNT];
+
+  if(ctx->remeshed_tile_count > 0)
+    ctx->is_isolines_mesh_compacted = false;
+
+  /* the metrics of the levels are those of the tiles, as they were last extracted */
+  for(int i = 0; i < THRESHOLD_COUNT; i++)
+  {
+    reset_level_metrics(&ctx->isolines_level_metrics[i]);
+    for(int tile_col = 0; tile_col < PYRAMID_TILE_COL_COUNT; tile_col++)
+      for(int tile_row = 0; tile_row < PYRAMID_TILE_ROW_COUNT; tile_row++)
+        merge_level_metrics(&ctx->isolines_level_metrics[i],
+                            &ctx->tile_level_metrics[tile_col][tile_row][i]);
+    add_border_metrics(ctx, &ctx->isolines_level_metrics[i], ctx->thresholds[i], 1,
+                       &ctx->isolines_mesh_region);
+  }
+}
+
+/* marks every tile mesh stale so all are re-extracted */
+static void
+invalidate_tile_meshes(struct isolines_context_t *ctx)
+{
+  for(int tile_col = 0; tile_col < PYRAMID_TILE_COL_COUNT; tile_col++)
+    for(int tile_row = 0; tile_row < PYRAMID_TILE_ROW_COUNT; tile_row++)
+      ctx->stale_tiles[tile_col][tile_row] = true;
+}
+
+/* evaluates the samples of the cells of the region, on the lattice of 'stride' (1 for every 
+ * sample); the pyramid is built only from the samples of a stride of 1, since the extraction from
+ * a coarser lattice does not use it */
+static void
+tick_grid(struct isolines_context_t *ctx, int stride, const struct cell_region_t *region)
+{
+  struct point2d_t sample_pos_g_m;
+  float r, g, b;
+  float *weight;
+
+  for(int col = region->col0; col <= region->col1; 
+      col = get_next_lattice_index(col, stride, SAMPLE_GRID_COL_COUNT))
+  {
+    for(int row = region->row0; row <= region->row1; 
+        row = get_next_lattice_index(row, stride, SAMPLE_GRID_ROW_COUNT))
+    {
+      weight = &ctx->grid.samples[col][row].weight;
+      sample_pos_g_m = get_sample_vertex(ctx, col, row);
+      *weight = calculate_sample_weights_sum(ctx, sample_pos_g_m);
+      weight_to_color(*weight, &r, &g, &b);
+      set_sample_color(ctx, col, row, r, g, b);
+    }
+  }
+
+  if(stride == 1)
+    build_pyramid(ctx, region);
+}
+
+/* draws the segments of a piece of a mesh in the colours of their levels; the piece holds the 
+ * 'component_count' components from offset 'first' of a mesh with the level offsets given */
+static void
+draw_isolines_mesh_levels(const GLfloat *components, int first, int component_count, 
+                          const int *level_offsets)
+{
+  float brightness;
+  int level_first, level_last;
+
+  glVertexPointer(2, GL_FLOAT, 0, components);
+
+  for(int i = 0; i < THRESHOLD_COUNT; i++)
+  {
+    level_first = (level_offsets[i] > first) ? level_offsets[i] : first;
+    level_last = (level_offsets[i + 1] < first + component_count) ? level_offsets[i + 1] : 
+                                                                   first + component_count;
+    if(level_first >= level_last)
+      continue;
+
+    /* the higher the level the brighter */
+    brightness = 0.5f + (0.5f * i / (THRESHOLD_COUNT - 1));
+    glColor3f(ISOLINES_MESH_COLOR_R * brightness, 
+              ISOLINES_MESH_COLOR_G * brightness, 
+              ISOLINES_MESH_COLOR_B * brightness);
+    glDrawArrays(GL_LINES, (level_first - first) >> 1, (level_last - level_first) >> 1);
+  }
+}
+
+static void
+draw_isolines_mesh(struct isolines_context_t *ctx)
+{
+  struct isolines_mesh_slab_t *slab;
+  struct mesh_chunk_t *mesh;
+  int first;
+
+  glDisableClientState(GL_COLOR_ARRAY);
+  glLineWidth(ISOLINES_MESH_DRAW_WIDTH_PX);
+
+  if(ctx->extraction_mode == ISOLINES_EXTRACT_INCREMENTAL)
+  {
+    for(int tile_col = 0; tile_col < PYRAMID_TILE_COL_COUNT; tile_col++)
+    {
+      for(int tile_row = 0; tile_row < PYRAMID_TILE_ROW_COUNT; tile_row++)
+      {
+        mesh = &ctx->tile_meshes[tile_col][tile_row];
+        if(mesh->component_count == 0)
+          continue;
+        draw_isolines_mesh_levels(mesh->components, 0, mesh->component_count, 
+                                  ctx->tile_mesh_level_offsets[tile_col][tile_row]);
+      }
+    }
+  }
+  else if(ISOLINES_USE_MESH_SLABS && !ISOLINES_COMPACT_MESH_SLABS)
+  {
+    first = 0;
+    for(slab = ctx->isolines_mesh_slabs.head; slab != NULL; slab = slab->next)
+    {
+      draw_isolines_mesh_levels(slab->components, first, slab->component_count, 
+                                ctx->isolines_mesh_level_offsets);
+      first += slab->component_count;
+    }
+  }
+  else
+  {
+    mesh = ISOLINES_USE_MESH_SLABS ? &ctx->compacted_isolines_mesh : &ctx->isolines_mesh;
+    draw_isolines_mesh_levels(mesh->components, 0, mesh->component_count, 
+                              ctx->isolines_mesh_level_offsets);
+  }
+
+  glLineWidth(1.f);
+}
+
+static void
+draw_isolines_polylines(struct isolines_context_t *ctx)
+{
+  struct isoline_polyline_t *polyline;
+
+  glDisableClientState(GL_COLOR_ARRAY);
+  glColor3f(ISOLINES_MESH_COLOR_R, ISOLINES_MESH_COLOR_G, ISOLINES_MESH_COLOR_B);
+  glLineWidth(ISOLINES_MESH_DRAW_WIDTH_PX);
+  glVertexPointer(2, GL_FLOAT, 0, ctx->isolines_polyline_mesh);
+  for(int i = 0; i < ctx->isolines_polyline_count; i++)
+  {
+    polyline = &ctx->isolines_polylines[i];
+    glDrawArrays(polyline->is_closed ? GL_LINE_LOOP : GL_LINE_STRIP, 
+                 polyline->first_vertex, 
+                 polyline->vertex_count);
+  }
+  glLineWidth(1.f);
+}
+
+static void
+draw_isobands(struct isolines_context_t *ctx)
+{
+  float brightness;
+
+  glDisableClientState(GL_COLOR_ARRAY);
+  glVertexPointer(2, GL_FLOAT, 0, ctx->isoband_vertices);
+  for(int i = 0; i < BAND_COUNT; i++)
+  {
+    /* the higher the band the brighter */
+    brightness = (float)(i + 1) / BAND_COUNT;
+    glColor3f(BAND_COLOR_R * brightness, BAND_COLOR_G * brightness, BAND_COLOR_B * brightness);
+    glDrawElements(GL_TRIANGLES, ctx->isoband_index_counts[i], GL_UNSIGNED_INT,
+                   ctx->isoband_indices[i]);
+  }
+}
+
+static void
+draw_isolines_dual(struct isolines_context_t *ctx)
+{
+  float brightness;
+  int first;
+
+  glDisableClientState(GL_COLOR_ARRAY);
+  glLineWidth(ISOLINES_MESH_DRAW_WIDTH_PX);
+  glVertexPointer(2, GL_FLOAT, 0, ctx->dual_vertices);
+  for(int i = 0; i < THRESHOLD_COUNT; i++)
+  {
+    first = ctx->dual_threshold_offsets[i];
+
+    /* the higher the level the brighter */
+    brightness = 0.5f + (0.5f * i / (THRESHOLD_COUNT - 1));
+    glColor3f(ISOLINES_MESH_COLOR_R * brightness, 
+              ISOLINES_MESH_COLOR_G * brightness, 
+              ISOLINES_MESH_COLOR_B * brightness);
+    glDrawElements(GL_LINES, ctx->dual_threshold_offsets[i + 1] - first, GL_UNSIGNED_INT, 
+                   &ctx->dual_indices[first]);
+  }
+  glLineWidth(1.f);
+}
+
+/*** DUAL ****************************************************************************************/
+
+/* estimates the gradient of the field at the sample by central differences (or one sided 
+ * differences on the border of the grid) */
+static struct vector2d_t
+get_sample_gradient(struct isolines_context_t *ctx, int col, int row)
+{
+  int col0 = (col > 0) ? col - 1 : col;
+  int col1 = (col < SAMPLE_GRID_COL_COUNT - 1) ? col + 1 : col;
+  int row0 = (row > 0) ? row - 1 : row;
+  int row1 = (row < SAMPLE_GRID_ROW_COUNT - 1) ? row + 1 : row;
+
+  return (struct vector2d_t){
+    (ctx->grid.samples[col1][row].weight - ctx->grid.samples[col0][row].weight) / 
+      ((col1 - col0) * CELL_SIZE_M),
+    (ctx->grid.samples[col][row1].weight - ctx->grid.samples[col][row0].weight) / 
+      ((row1 - row0) * CELL_SIZE_M)
+  };
+}
+
+/* places the vertex of the cell (col, row), whose corners' state w.r.t the threshold is given by
+ * the mask, and adds it to the dual vertices; returns its index */
+static int
+add_dual_vertex(struct isolines_context_t *ctx, int col, int row, uint8_t state_mask, 
+                float threshold)
+{
+  static const int corner_cols[4] = {0, 1, 1, 0};
+  static const int corner_rows[4] = {0, 0, 1, 1};
+
+  struct point2d_t points[4], mean = {0.f, 0.f}, vertex;
+  struct vector2d_t normals[4], gradient0, gradient1;
+  float a00, a01, a11, b0, b1, det, length, offset, w0, w1;
+  int point_count = 0, c0, r0, c1, r1;
+
+  /* the crossing points of the edges of the cell, anticlockwise from the bottom edge */
+  for(int i = 0; i < 4; i++)
+  {
+    if(((state_mask >> i) & 1) == ((state_mask >> ((i + 1) % 4)) & 1))
+      continue;
+
+    c0 = col + corner_cols[i];
+    r0 = row + corner_rows[i];
+    c1 = col + corner_cols[(i + 1) % 4];
+    r1 = row + corner_rows[(i + 1) % 4];
+    w0 = ctx->grid.samples[c0][r0].weight;
+    w1 = ctx->grid.samples[c1][r1].weight;
+    offset = (threshold - w0) / (w1 - w0);
+
+    points[point_count].x = (c0 + ((c1 - c0) * offset)) * CELL_SIZE_M;
+    points[point_count].y = (r0 + ((r1 - r0) * offset)) * CELL_SIZE_M;
+    mean.x += points[point_count].x;
+    mean.y += points[point_count].y;
+
+    if(ISOLINES_DUAL_USE_GRADIENTS)
+    {
+      gradient0 = get_sample_gradient(ctx, c0, r0);
+      gradient1 = get_sample_gradient(ctx, c1, r1);
+      normals[point_count].x = gradient0.x + ((gradient1.x - gradient0.x) * offset);
+      normals[point_count].y = gradient0.y + ((gradient1.y - gradient0.y) * offset);
+      length = sqrtf((normals[point_count].x * normals[point_count].x) + 
+                     (normals[point_count].y * normals[point_count].y));
+      normals[point_count].x = (length > 0.f) ? normals[point_count].x / length : 0.f;
+      normals[point_count].y = (length > 0.f) ? normals[point_count].y / length : 0.f;
+    }
+
+    ++point_count;
+  }
+
+  assert(point_count == 2 || point_count == 4);
+
+  mean.x /= point_count;
+  mean.y /= point_count;
+  vertex = mean;
+
+  if(ISOLINES_DUAL_USE_GRADIENTS)
+  {
+    /* solves (sum(n n^T) + bias I) v = sum(n n^T p) + bias mean, relative to the mean */
+    a00 = a11 = ISOLINES_DUAL_MEAN_BIAS;
+    a01 = b0 = b1 = 0.f;
+    for(int i = 0; i < point_count; i++)
+    {
+      offset = (normals[i].x * (points[i].x - mean.x)) + (normals[i].y * (points[i].y - mean.y));
+      a00 += normals[i].x * normals[i].x;
+      a01 += normals[i].x * normals[i].y;
+      a11 += normals[i].y * normals[i].y;
+      b0 += normals[i].x * offset;
+      b1 += normals[i].y * offset;
+    }
+
+    det = (a00 * a11) - (a01 * a01);
+    vertex.x = mean.x + (((a11 * b0) - (a01 * b1)) / det);
+    vertex.y = mean.y + (((a00 * b1) - (a01 * b0)) / det);
+
+    /* the vertex is kept within its cell */
+    vertex.x = fminf(fmaxf(vertex.x, col * CELL_SIZE_M), (col + 1) * CELL_SIZE_M);
+    vertex.y = fminf(fmaxf(vertex.y, row * CELL_SIZE_M), (row + 1) * CELL_SIZE_M);
+  }
+
+  ctx->dual_vertices = xreserve(ctx->dual_vertices, &ctx->dual_vertex_capacity, 
+                                (ctx->dual_vertex_count + 1) * 2, sizeof(GLfloat));
+  ctx->dual_vertices[(ctx->dual_vertex_count * 2) + 0] = vertex.x;
+  ctx->dual_vertices[(ctx->dual_vertex_count * 2) + 1] = vertex.y;
+
+  return ctx->dual_vertex_count++;
+}
+
+/* adds the segment from the vertex 'from' to the vertex 'to' */
+static void
+add_dual_segment(struct isolines_context_t *ctx, int from, int to)
+{
+  assert(from != DUAL_VERTEX_NULL && to != DUAL_VERTEX_NULL);
+
+  ctx->dual_indices = xreserve(ctx->dual_indices, &ctx->dual_index_capacity, 
+                               ctx->dual_index_count + 2, sizeof(GLuint));
+  ctx->dual_indices[ctx->dual_index_count++] = from;
+  ctx->dual_indices[ctx->dual_index_count++] = to;
+}
+
+/* extracts the dual isolines of a threshold, column by column; each crossed cell is joined to 
+ * the cells left of and below it across their shared edge (if crossed). The segments are 
+ * oriented with the weights at or above the threshold on their left, as the other extractions. */
+static void
+generate_isolines_dual(struct isolines_context_t *ctx, int threshold_id)
+{
+  float threshold = ctx->thresholds[threshold_id];
+  int *left_ids, *ids;
+  uint8_t state_mask;
+
+  ctx->dual_threshold_offsets[threshold_id] = ctx->dual_index_count;
+
+  for(int col = 0; col < SAMPLE_GRID_COL_COUNT - 1; col++)
+  {
+    left_ids = ctx->dual_column_vertex_ids[(col + 1) % 2];
+    ids = ctx->dual_column_vertex_ids[col % 2];
+
+    for(int row = 0; row < SAMPLE_GRID_ROW_COUNT - 1; row++)
+    {
+      state_mask = 0;
+      if(ctx->grid.samples[col  ][row  ].weight >= threshold) SET_CORNER(0b0001, state_mask);
+      if(ctx->grid.samples[col+1][row  ].weight >= threshold) SET_CORNER(0b0010, state_mask);
+      if(ctx->grid.samples[col+1][row+1].weight >= threshold) SET_CORNER(0b0100, state_mask);
+      if(ctx->grid.samples[col  ][row+1].weight >= threshold) SET_CORNER(0b1000, state_mask);
+
+      if(state_mask == 0b0000 || state_mask == 0b1111)
+      {
+        ids[row] = DUAL_VERTEX_NULL;
+        continue;
+      }
+
+      ids[row] = add_dual_vertex(ctx, col, row, state_mask, threshold);
+
+      /* the bottom edge; with its left (bottom-left) corner active the region is on the left 
+       * going upwards */
+      if(row > 0 && ((state_mask & 0b0001) != 0) != ((state_mask & 0b0010) != 0))
+      {
+        if(state_mask & 0b0001)
+          add_dual_segment(ctx, ids[row - 1], ids[row]);
+        else
+          add_dual_segment(ctx, ids[row], ids[row - 1]);
+      }
+
+      /* the left edge; with its bottom (bottom-left) corner active the region is on the left 
+       * going leftwards */
+      if(col > 0 && ((state_mask & 0b0001) != 0) != ((state_mask & 0b1000) != 0))
+      {
+        if(state_mask & 0b0001)
+          add_dual_segment(ctx, ids[row], left_ids[row]);
+        else
+          add_dual_segment(ctx, left_ids[row], ids[row]);
+      }
+    }
+  }
+
+  ctx->dual_threshold_offsets[threshold_id + 1] = ctx->dual_index_count;
+}
+
+static void
+reset_isolines_dual(struct isolines_context_t *ctx)
+{
+  ctx->dual_vertex_count = 0;
+  ctx->dual_index_count = 0;
+}
+
+/*** STREAMING ***********************************************************************************/
+
+/* lerps the crossing points of every threshold along the edges of the last line pushed */
+static void
+lerp_stream_edges(struct isolines_stream_t *stream)
+{
+  const float *w = stream->weights;
+  float threshold, *points;
+  int edge_count = stream->line_length - 1;
+
+  for(int i = 0; i < stream->threshold_count; i++)
+  {
+    threshold = stream->thresholds[i];
+    points = &stream->edge_points[i * edge_count];
+
+    for(int j = 0; j < edge_count; j++)
+      if((w[j] >= threshold) != (w[j + 1] >= threshold))
+        points[j] = (j * stream->cell_size_m) + lerp(threshold, w[j], w[j + 1], 
+                                                     stream->cell_size_m);
+  }
+}
+
+static void
+push_stream_point(struct isolines_stream_t *stream, float x, float y)
+{
+  stream->components = xreserve(stream->components, &stream->component_capacity, 
+                                stream->component_count + 2, sizeof(float));
+  stream->components[stream->component_count++] = x;
+  stream->components[stream->component_count++] = y;
+}
+
+/* the x coordinate of the crossing point of the threshold along the row between the last two 
+ * lines pushed; lerped from the left sample */
+static float
+get_stream_row_point(struct isolines_stream_t *stream, int row, float threshold, float left_x)
+{
+  float w0 = stream->prev_weights[row], w1 = stream->weights[row];
+
+  return left_x + lerp(threshold, w0, w1, stream->cell_size_m);
+}
+
+/* extracts the column of cells between the last two lines pushed, threshold by threshold and 
+ * each from the bottom cell up. The left and right points are those lerped along the lines; the 
+ * bottom and top points are lerped along the rows, the top point of each cell being carried up 
+ * as the bottom point of the cell above it. */
+static void
+generate_stream_column(struct isolines_stream_t *stream)
+{
+  const float *left = stream->prev_weights, *right = stream->weights;
+  const int8_t *indices;
+  struct point2d_t points[4];
+  float weights[4], threshold, left_x, right_x, top_x = 0.f;
+  int edge_count = stream->line_length - 1, edge;
+  uint8_t state_mask;
+
+  left_x = (stream->line_count - 2) * stream->cell_size_m;
+  right_x = (stream->line_count - 1) * stream->cell_size_m;
+
+  stream->component_count = 0;
+
+  for(int i = 0; i < stream->threshold_count; i++)
+  {
+    threshold = stream->thresholds[i];
+    stream->level_offsets[i] = stream->component_count;
+
+    if((left[0] >= threshold) != (right[0] >= threshold))
+      top_x = get_stream_row_point(stream, 0, threshold, left_x);
+
+    for(int row = 0; row < edge_count; row++)
+    {
+      weights[CELL_WEIGHT_BL] = left[row];
+      weights[CELL_WEIGHT_BR] = right[row];
+      weights[CELL_WEIGHT_TR] = right[row + 1];
+      weights[CELL_WEIGHT_TL] = left[row + 1];
+      state_mask = get_cell_state_mask(weights, threshold);
+
+      /* the bottom edge of the cell is the top edge of the cell below it */
+      points[CELL_POINT_B].x = top_x;
+      points[CELL_POINT_B].y = row * stream->cell_size_m;
+
+      if((left[row + 1] >= threshold) != (right[row + 1] >= threshold))
+        top_x = get_stream_row_point(stream, row + 1, threshold, left_x);
+
+      indices = cell_lookup[state_mask];
+      if(indices[0] == CELL_POINT_NULL)
+        continue;
+
+      edge = (i * edge_count) + row;
+      points[CELL_POINT_L] = (struct point2d_t){left_x, stream->prev_edge_points[edge]};
+      points[CELL_POINT_R] = (struct point2d_t){right_x, stream->edge_points[edge]};
+      points[CELL_POINT_T] = (struct point2d_t){top_x, (row + 1) * stream->cell_size_m};
+
+      for(int j = 0; j < 4 && indices[j] != CELL_POINT_NULL; j++)
+        push_stream_point(stream, points[indices[j]].x, points[indices[j]].y);
+    }
+  }
+
+  stream->level_offsets[stream->threshold_count] = stream->component_count;
+}
+
+/*** RASTERS *************************************************************************************/
+
+/* the key of the vertical edge at the raster sample (col, row), or of the horizontal edge */
+static int64_t
+get_raster_edge_key(const struct isolines_raster_t *raster, int col, int row, bool is_horizontal)
+{
+  return ((((int64_t)col * raster->row_count) + row) * 2) + (is_horizontal ? 1 : 0);
+}
+
+/* the stitch vertex on the side 'side' (CELL_POINT_*) of the cell (col, row) of the tile whose 
+ * bottom-left sample is (col0, row0) of the raster, of 'col_count' x 'row_count' cells; the 
+ * vertex is added the first time the edge is reached */
+static int
+get_raster_tile_vertex(struct isolines_context_t *ctx, struct raster_scratch_t *scratch, 
+                       int col0, int row0, int col_count, int row_count, int col, int row, 
+                       int8_t side, float threshold)
+{
+  const struct isolines_raster_t *raster = ctx->raster;
+  struct stitch_vertex_t *vertex;
+  bool is_horizontal = (side == CELL_POINT_B || side == CELL_POINT_T);
+  bool is_border;
+  float w0, w1, offset;
+  int edge;
+
+  col += (side == CELL_POINT_R) ? 1 : 0;
+  row += (side == CELL_POINT_T) ? 1 : 0;
+
+  if(is_horizontal)
+    edge = ((col_count + 1) * row_count) + (col * (row_count + 1)) + row;
+  else
+    edge = (col * row_count) + row;
+
+  if(scratch->edge_vertex_ids[edge] != STITCH_LINK_NULL)
+    return scratch->edge_vertex_ids[edge];
+
+  scratch->vertices = xreserve(scratch->vertices, &scratch->vertex_capacity, 
+                               scratch->vertex_count + 1, sizeof(struct stitch_vertex_t));
+  scratch->vertex_keys = xreserve(scratch->vertex_keys, &scratch->vertex_key_capacity, 
+                                  scratch->vertex_count + 1, sizeof(int64_t));
+
+  vertex = &scratch->vertices[scratch->vertex_count];
+  w0 = scratch->weights[(col * (row_count + 1)) + row];
+  if(is_horizontal)
+  {
+    w1 = scratch->weights[((col + 1) * (row_count + 1)) + row];
+    offset = (threshold - w0) / (w1 - w0);
+    vertex->point.x = (col0 + col + offset) * raster->cell_size_m;
+    vertex->point.y = (row0 + row) * raster->cell_size_m;
+    is_border = (row0 + row == 0 || row0 + row == raster->row_count - 1);
+  }
+  else
+  {
+    w1 = scratch->weights[(col * (row_count + 1)) + row + 1];
+    offset = (threshold - w0) / (w1 - w0);
+    vertex->point.x = (col0 + col) * raster->cell_size_m;
+    vertex->point.y = (row0 + row + offset) * raster->cell_size_m;
+    is_border = (col0 + col == 0 || col0 + col == raster->col_count - 1);
+  }
+  vertex->links[0] = vertex->links[1] = STITCH_LINK_NULL;
+  vertex->is_visited = false;
+
+  scratch->vertex_keys[scratch->vertex_count] = is_border ? RASTER_KEY_NULL : 
+    get_raster_edge_key(raster, col0 + col, row0 + row, is_horizontal);
+
+  scratch->edge_vertex_ids[edge] = scratch->vertex_count;
+  return scratch->vertex_count++;
+}
+
+static void
+link_raster_tile_vertices(struct raster_scratch_t *scratch, int vertex_id, int other_vertex_id)
+{
+  struct stitch_vertex_t *vertex = &scratch->vertices[vertex_id];
+
+  assert(vertex->links[1] == STITCH_LINK_NULL);
+  vertex->links[(vertex->links[0] == STITCH_LINK_NULL) ? 0 : 1] = other_vertex_id;
+}
+
+/* walks the chain of linked vertices of the tile from the vertex 'start_id' into a new piece; as
+ * 'add_stitch_polyline' */
+static void
+add_raster_piece(struct raster_tile_t *tile, struct raster_scratch_t *scratch, int threshold_id,
+                 int start_id, bool is_closed)
+{
+  struct stitch_vertex_t *vertex;
+  struct raster_piece_t *piece;
+  int vertex_id, next_id, last_id = start_id;
+
+  tile->pieces = xreserve(tile->pieces, &tile->piece_capacity, tile->piece_count + 1, 
+                          sizeof(struct raster_piece_t));
+  piece = &tile->pieces[tile->piece_count++];
+  piece->threshold_id = threshold_id;
+  piece->first_vertex = tile->component_count >> 1;
+  piece->vertex_count = 0;
+  piece->is_closed = is_closed;
+  piece->is_visited = false;
+
+  vertex_id = start_id;
+  while(vertex_id != STITCH_LINK_NULL)
+  {
+    vertex = &scratch->vertices[vertex_id];
+    vertex->is_visited = true;
+
+    tile->vertices = xreserve(tile->vertices, &tile->component_capacity, 
+                              tile->component_count + 2, sizeof(GLfloat));
+    tile->vertices[tile->component_count++] = vertex->point.x;
+    tile->vertices[tile->component_count++] = vertex->point.y;
+    ++piece->vertex_count;
+    last_id = vertex_id;
+
+    next_id = vertex->links[0];
+    if(next_id == STITCH_LINK_NULL || scratch->vertices[next_id].is_visited)
+      next_id = vertex->links[1];
+    if(next_id != STITCH_LINK_NULL && scratch->vertices[next_id].is_visited)
+      next_id = STITCH_LINK_NULL;
+
+    vertex_id = next_id;
+  }
+
+  /* only the ends of open pieces lie on seams */
+  piece->keys[0] = is_closed ? RASTER_KEY_NULL : scratch->vertex_keys[start_id];
+  piece->keys[1] = is_closed ? RASTER_KEY_NULL : scratch->vertex_keys[last_id];
+}
+
+/* extracts the pieces of every threshold from the tile of 'col_count' x 'row_count' cells whose 
+ * bottom-left sample is (col0, row0) of the raster; its samples must be in the scratch */
+static void
+extract_raster_tile(struct isolines_context_t *ctx, struct raster_scratch_t *scratch, 
+                    struct raster_tile_t *tile, int col0, int row0, int col_count, int row_count)
+{
+  const struct isolines_raster_t *raster = ctx->raster;
+  const int8_t *indices;
+  const float *w;
+  float weights[4], threshold;
+  int edge_count = ((col_count + 1) * row_count) + (col_count * (row_count + 1)), vertex_ids[4];
+  uint8_t state_mask;
+
+  scratch->edge_vertex_ids = xreserve(scratch->edge_vertex_ids, 
+                                      &scratch->edge_vertex_id_capacity, 
+                                      edge_count, sizeof(int));
+
+  for(int i = 0; i < raster->threshold_count; i++)
+  {
+    threshold = raster->thresholds[i];
+    scratch->vertex_count = 0;
+    for(int j = 0; j < edge_count; j++)
+      scratch->edge_vertex_ids[j] = STITCH_LINK_NULL;
+
+    for(int col = 0; col < col_count; col++)
+    {
+      for(int row = 0; row < row_count; row++)
+      {
+        w = &scratch->weights[(col * (row_count + 1)) + row];
+
+        weights[CELL_WEIGHT_BL] = w[0];
+        weights[CELL_WEIGHT_BR] = w[row_count + 1];
+        weights[CELL_WEIGHT_TR] = w[row_count + 1 + 1];
+        weights[CELL_WEIGHT_TL] = w[1];
+        state_mask = get_cell_state_mask(weights, threshold);
+
+        indices = cell_lookup[state_mask];
+        for(int j = 0; j < 4 && indices[j] != CELL_POINT_NULL; j++)
+          vertex_ids[j] = get_raster_tile_vertex(ctx, scratch, col0, row0, col_count, row_count,
+                                                 col, row, indices[j], threshold);
+
+        for(int j = 0; j < 4 && indices[j] != CELL_POINT_NULL; j += 2)
+        {
+          link_raster_tile_vertices(scratch, vertex_ids[j], vertex_ids[j + 1]);
+          link_raster_tile_vertices(scratch, vertex_ids[j + 1], vertex_ids[j]);
+        }
+      }
+    }
+
+    /* the open pieces start at their ends (which lie on the border of the tile); what remains 
+     * are loops */
+    for(int j = 0; j < scratch->vertex_count; j++)
+      if(!scratch->vertices[j].is_visited && scratch->vertices[j].links[1] == STITCH_LINK_NULL)
+        add_raster_piece(tile, scratch, i, j, false);
+
+    for(int j = 0; j < scratch->vertex_count; j++)
+      if(!scratch->vertices[j].is_visited)
+        add_raster_piece(tile, scratch, i, j, true);
+  }
+}
+
+/* reads the tile of the job and extracts its pieces */
+static void
+run_raster_tile_job(void *args, int job_id, int thread_id)
+{
+  struct isolines_context_t *ctx = args;
+  const struct isolines_raster_t *raster = ctx->raster;
+  struct raster_scratch_t *scratch = &ctx->raster_scratches[thread_id];
+  struct raster_tile_t *tile = &ctx->raster_tiles[job_id];
+  int col0, row0, col_count, row_count;
+
+  tile->component_count = 0;
+  tile->piece_count = 0;
+
+  /* tiles are ordered column by column, as the samples are */
+  col0 = (job_id / ctx->raster_tile_row_count) * ISOLINES_RASTER_TILE_SIZE;
+  row0 = (job_id % ctx->raster_tile_row_count) * ISOLINES_RASTER_TILE_SIZE;
+  col_count = raster->col_count - 1 - col0;
+  col_count = (col_count < ISOLINES_RASTER_TILE_SIZE) ? col_count : ISOLINES_RASTER_TILE_SIZE;
+  row_count = raster->row_count - 1 - row0;
+  row_count = (row_count < ISOLINES_RASTER_TILE_SIZE) ? row_count : ISOLINES_RASTER_TILE_SIZE;
+
+  scratch->weights = xreserve(scratch->weights, &scratch->weight_capacity, 
+                              (col_count + 1) * (row_count + 1), sizeof(float));
+
+  if(!raster->read(raster->user, col0, row0, col_count + 1, row_count + 1, scratch->weights))
+  {
+    __atomic_store_n(&ctx->is_raster_read_failed, true, __ATOMIC_RELAXED);
+    return;
+  }
+
+  extract_raster_tile(ctx, scratch, tile, col0, row0, col_count, row_count);
+}
+
+/* the slot of the table of seams holding the key, or the empty slot it would be added to */
+static struct raster_seam_t *
+find_raster_seam(struct isolines_context_t *ctx, int64_t key)
+{
+  uint64_t slot = ((uint64_t)key * 0x9e3779b97f4a7c15ull) >> 32;
+  struct raster_seam_t *seam;
+
+  while(true)
+  {
+    seam = &ctx->raster_seams[slot & (ctx->raster_seam_table_size - 1)];
+    if(seam->key == key || seam->key == RASTER_KEY_NULL)
+      return seam;
+    ++slot;
+  }
+}
+
+/* fills the table of seams with the ends of the open pieces of the threshold */
+static void
+build_raster_seams(struct isolines_context_t *ctx, int threshold_id)
+{
+  struct raster_piece_t *piece;
+  struct raster_seam_t *seam;
+  int tile_count = ctx->raster_tile_col_count * ctx->raster_tile_row_count, end_count = 0;
+
+  for(int i = 0; i < tile_count; i++)
+    for(int j = 0; j < ctx->raster_tiles[i].piece_count; j++)
+      if(ctx->raster_tiles[i].pieces[j].threshold_id == threshold_id)
+        end_count += ctx->raster_tiles[i].pieces[j].is_closed ? 0 : 2;
+
+  /* at most half full, so the probes stay short */
+  ctx->raster_seam_table_size = 64;
+  while(ctx->raster_seam_table_size < end_count * 2)
+    ctx->raster_seam_table_size *= 2;
+
+  ctx->raster_seams = xreserve(ctx->raster_seams, &ctx->raster_seam_capacity, 
+                               ctx->raster_seam_table_size, sizeof(struct raster_seam_t));
+  for(int i = 0; i < ctx->raster_seam_table_size; i++)
+    ctx->raster_seams[i].key = RASTER_KEY_NULL;
+
+  for(int i = 0; i < tile_count; i++)
+  {
+    for(int j = 0; j < ctx->raster_tiles[i].piece_count; j++)
+    {
+      piece = &ctx->raster_tiles[i].pieces[j];
+      if(piece->threshold_id != threshold_id || piece->is_closed)
+        continue;
+
+      for(int end = 0; end < 2; end++)
+      {
+        if(piece->keys[end] == RASTER_KEY_NULL)
+          continue;
+
+        seam = find_raster_seam(ctx, piece->keys[end]);
+        if(seam->key == RASTER_KEY_NULL)
+        {
+          seam->key = piece->keys[end];
+          seam->end_count = 0;
+        }
+
+        assert(seam->end_count < 2);
+        seam->tiles[seam->end_count] = i;
+        seam->pieces[seam->end_count] = j;
+        seam->ends[seam->end_count] = end;
+        ++seam->end_count;
+      }
+    }
+  }
+}
+
+/* finds the piece end joined to the end 'end' of the piece; false if there is none (the end lies
+ * on the border of the raster, or the tile beyond the seam was not read) */
+static bool
+find_raster_partner(struct isolines_context_t *ctx, int tile, int piece, int end, 
+                    int *partner_tile, int *partner_piece, int *partner_end)
+{
+  int64_t key = ctx->raster_tiles[tile].pieces[piece].keys[end];
+  struct raster_seam_t *seam;
+
+  if(key == RASTER_KEY_NULL)
+    return false;
+
+  seam = find_raster_seam(ctx, key);
+  if(seam->key == RASTER_KEY_NULL)
+    return false;
+
+  for(int i = 0; i < seam->end_count; i++)
+  {
+    if(seam->tiles[i] == tile && seam->pieces[i] == piece && seam->ends[i] == end)
+      continue;
+
+    *partner_tile = seam->tiles[i];
+    *partner_piece = seam->pieces[i];
+    *partner_end = seam->ends[i];
+    return true;
+  }
+
+  return false;
+}
+
+/* joins the chain of pieces starting from the end 'end' of the piece into a polyline. Adjacent
+ * pieces share the vertex on their seam, which is written once; the last piece of a loop across
+ * seams ends on the vertex its first piece starts on, which is not repeated. */
+static void
+add_raster_polyline(struct isolines_context_t *ctx, int tile, int piece, int end, bool is_closed)
+{
+  struct isoline_polyline_t *polyline;
+  struct raster_piece_t *current;
+  const GLfloat *vertices;
+  int next_tile, next_piece, next_end, vertex;
+  bool has_next;
+
+  polyline = begin_polyline(ctx, is_closed);
+
+  while(true)
+  {
+    current = &ctx->raster_tiles[tile].pieces[piece];
+    current->is_visited = true;
+
+    has_next = find_raster_partner(ctx, tile, piece, 1 - end, &next_tile, &next_piece, &next_end);
+    if(has_next && ctx->raster_tiles[next_tile].pieces[next_piece].is_visited)
+      has_next = false;
+
+    vertices = &ctx->raster_tiles[tile].vertices[current->first_vertex * 2];
+    for(int i = (polyline->vertex_count > 0) ? 1 : 0; 
+        i < current->vertex_count - ((is_closed && !current->is_closed && !has_next) ? 1 : 0); 
+        i++)
+    {
+      vertex = (end == 0) ? i : current->vertex_count - 1 - i;
+      push_polyline_vertex(ctx, polyline, 
+                           (struct point2d_t){vertices[vertex * 2], vertices[(vertex * 2) + 1]});
+    }
+
+    if(!has_next)
+      break;
+
+    tile = next_tile;
+    piece = next_piece;
+    end = next_end;
+  }
+
+  end_polyline(ctx, polyline);
+}
+
+/* joins the pieces of the threshold of all tiles into polylines; first the closed pieces, then 
+ * the chains which end on the border of the raster (or at a tile which was not read), and lastly
+ * the loops which cross seams */
+static void
+stitch_raster_threshold(struct isolines_context_t *ctx, int threshold_id)
+{
+  struct raster_piece_t *piece;
+  int tile_count = ctx->raster_tile_col_count * ctx->raster_tile_row_count;
+  int partner_tile, partner_piece, partner_end;
+
+  build_raster_seams(ctx, threshold_id);
+
+  for(int pass = 0; pass < 3; pass++)
+  {
+    for(int i = 0; i < tile_count; i++)
+    {
+      for(int j = 0; j < ctx->raster_tiles[i].piece_count; j++)
+      {
+        piece = &ctx->raster_tiles[i].pieces[j];
+        if(piece->threshold_id != threshold_id || piece->is_visited)
+          continue;
+
+        if(pass == 0 && piece->is_closed)
+          add_raster_polyline(ctx, i, j, 0, true);
+        else if(pass == 1 && !piece->is_closed)
+        {
+          for(int end = 0; end < 2; end++)
+          {
+            if(!find_raster_partner(ctx, i, j, end, &partner_tile, &partner_piece, &partner_end))
+            {
+              add_raster_polyline(ctx, i, j, end, false);
+              break;
+            }
+          }
+        }
+        else if(pass == 2)
+          add_raster_polyline(ctx, i, j, 0, true);
+      }
+    }
+  }
+}
+
+/* frees the pieces of all tiles once they have been stitched, so that between extractions only
+ * the polylines are held rather than twice the output of the raster */
+static void
+release_raster_tiles(struct isolines_context_t *ctx)
+{
+  for(int i = 0; i < ctx->raster_tile_capacity; i++)
+  {
+    free(ctx->raster_tiles[i].vertices);
+    free(ctx->raster_tiles[i].pieces);
+    memset((void *)&ctx->raster_tiles[i], 0, sizeof(struct raster_tile_t));
+  }
+}
+
+/*** BATCH ***************************************************************************************/
+
+/* the weights of the corners of the cell (col, row) of the field, in the order of the bits of the
+ * state mask */
+static inline void
+get_field_cell_weights(const struct isolines_field_t *field, int col, int row, float weights[4])
+{
+  const float *left = &field->weights[(col * field->row_count) + row];
+  const float *right = left + field->row_count;
+
+  weights[CELL_WEIGHT_BL] = left[0];
+  weights[CELL_WEIGHT_BR] = right[0];
+  weights[CELL_WEIGHT_TR] = right[1];
+  weights[CELL_WEIGHT_TL] = left[1];
+}
+
+/* the number of state masks (cells) of the columns of cells [col0, col1) of a level of the 
+ * field */
+static int
+get_field_state_mask_count(const struct isolines_field_t *field, int col0, int col1)
+{
+  if(col1 <= col0 || field->row_count < 2)
+    return 0;
+
+  return (col1 - col0) * (field->row_count - 1);
+}
+
+/* counts the segments of the columns of cells [col0, col1) of the field at the threshold, and 
+ * writes the state mask of each of its cells (column by column) to 'state_masks' so the 
+ * extraction need not compute them again */
+static int
+count_field_segments(const struct isolines_field_t *field, float threshold, int col0, int col1,
+                     uint8_t *state_masks)
+{
+  float weights[4];
+  int segment_count = 0;
+
+  for(int col = col0; col < col1; col++)
+  {
+    for(int row = 0; row < field->row_count - 1; row++)
+    {
+      get_field_cell_weights(field, col, row, weights);
+      *state_masks = get_cell_state_mask(weights, threshold);
+      segment_count += cell_segment_counts[*state_masks++];
+    }
+  }
+
+  return segment_count;
+}
+
+/* extracts the segments of the columns of cells [col0, col1) of the field at the threshold into
+ * 'components', from the state masks written by 'count_field_segments'; returns the component 
+ * count written. Each edge is lerped once, as in 'lerp_cell': the crossings of the right edges 
+ * of a column of cells are kept in 'edge_points' (room for two columns of row_count - 1) for the
+ * column to its right, and the crossing of the top edge of a cell for the cell above it. */
+static int
+generate_field_segments(const struct isolines_field_t *field, float threshold, int col0, 
+                        int col1, const uint8_t *state_masks, float *edge_points, 
+                        GLfloat *components)
+{
+  struct point2d_t points[4];
+  const int8_t *indices;
+  const float *left_points = NULL;
+  float *right_points = edge_points, weights[4], top_x = 0.f, bottom_x;
+  float cell_size_m = field->cell_size_m;
+  int cell_row_count = field->row_count - 1, component_count = 0;
+
+  for(int col = col0; col < col1; col++)
+  {
+    for(int row = 0; row < cell_row_count; row++)
+    {
+      indices = cell_lookup[*state_masks++];
+      if(indices[0] == CELL_POINT_NULL)
+        continue;
+
+      get_field_cell_weights(field, col, row, weights);
+
+      /* the top point of the cell below, before the top point of this cell replaces it */
+      bottom_x = top_x;
+
+      for(int i = 0; i < 4 && indices[i] != CELL_POINT_NULL; i++)
+      {
+        switch(indices[i])
+        {
+        case CELL_POINT_L:
+          points[CELL_POINT_L].x = col * cell_size_m;
+          points[CELL_POINT_L].y = (left_points != NULL) ? left_points[row] : 
+                                   (row * cell_size_m) + lerp(threshold, 
+                                                              weights[CELL_WEIGHT_BL], 
+                                                              weights[CELL_WEIGHT_TL], 
+                                                              cell_size_m);
+          break;
+        case CELL_POINT_B:
+          points[CELL_POINT_B].x = (row > 0) ? bottom_x : 
+                                   (col * cell_size_m) + lerp(threshold, 
+                                                              weights[CELL_WEIGHT_BL], 
+                                                              weights[CELL_WEIGHT_BR], 
+                                                              cell_size_m);
+          points[CELL_POINT_B].y = row * cell_size_m;
+          break;
+        case CELL_POINT_R:
+          right_points[row] = (row * cell_size_m) + lerp(threshold, weights[CELL_WEIGHT_BR], 
+                                                         weights[CELL_WEIGHT_TR], cell_size_m);
+          points[CELL_POINT_R].x = (col + 1) * cell_size_m;
+          points[CELL_POINT_R].y = right_points[row];
+          break;
+        case CELL_POINT_T:
+          top_x = (col * cell_size_m) + lerp(threshold, weights[CELL_WEIGHT_TL], 
+                                             weights[CELL_WEIGHT_TR], cell_size_m);
+          points[CELL_POINT_T].x = top_x;
+          points[CELL_POINT_T].y = (row + 1) * cell_size_m;
+          break;
+        }
+
+        components[component_count++] = points[indices[i]].x;
+        components[component_count++] = points[indices[i]].y;
+      }
+    }
+
+    /* the right edges of this column are the left edges of the next */
+    left_points = right_points;
+    right_points = (right_points == edge_points) ? &edge_points[cell_row_count] : edge_points;
+  }
+
+  return component_count;
+}
+
+/* the cost of extracting all levels of the field (see ISOLINES_BATCH_JOB_COST) */
+static int
+get_field_cost(const struct isolines_field_t *field)
+{
+  if(field->col_count < 2 || field->row_count < 2)
+    return 0;
+
+  return (field->col_count - 1) * (field->row_count - 1) * field->threshold_count;
+}
+
+static struct batch_job_t *
+push_batch_job(struct isolines_context_t *ctx, int field_id, int col0, int col1, int *slot_count)
+{
+  struct batch_job_t *job;
+
+  ctx->batch_jobs = xreserve(ctx->batch_jobs, &ctx->batch_job_capacity, 
+                             ctx->batch_job_count + 1, sizeof(struct batch_job_t));
+  job = &ctx->batch_jobs[ctx->batch_job_count++];
+  job->first_field = field_id;
+  job->field_count = 1;
+  job->col0 = col0;
+  job->col1 = col1;
+  job->first_slot = *slot_count;
+  *slot_count += ctx->batch_fields[field_id].threshold_count;
+
+  return job;
+}
+
+/* splits the fields of the batch into jobs (see 'struct batch_job_t'); returns the slot count */
+static int
+plan_batch_jobs(struct isolines_context_t *ctx, int field_count)
+{
+  const struct isolines_field_t *field;
+  struct batch_job_t *group = NULL;
+  int cost, group_cost = 0, slot_count = 0, cell_col_count, strip_count, strip_width;
+
+  ctx->batch_job_count = 0;
+
+  for(int i = 0; i < field_count; i++)
+  {
+    field = &ctx->batch_fields[i];
+    cost = get_field_cost(field);
+
+    if(cost > ISOLINES_BATCH_JOB_COST)
+    {
+      cell_col_count = field->col_count - 1;
+      strip_count = (cost + ISOLINES_BATCH_JOB_COST - 1) / ISOLINES_BATCH_JOB_COST;
+      strip_count = (strip_count < cell_col_count) ? strip_count : cell_col_count;
+      strip_width = (cell_col_count + strip_count - 1) / strip_count;
+
+      for(int col0 = 0; col0 < cell_col_count; col0 += strip_width)
+        push_batch_job(ctx, i, col0, 
+                       (col0 + strip_width < cell_col_count) ? col0 + strip_width : cell_col_count,
+                       &slot_count);
+
+      group = NULL;
+    }
+    else if(group != NULL && group_cost + cost <= ISOLINES_BATCH_JOB_COST)
+    {
+      ++group->field_count;
+      slot_count += field->threshold_count;
+      group_cost += cost;
+    }
+    else
+    {
+      group = push_batch_job(ctx, i, 0, INT_MAX, &slot_count);
+      group_cost = cost;
+    }
+  }
+
+  return slot_count;
+}
+
+/* the column range of the field 'field_id' covered by the job */
+static void
+get_batch_job_cols(struct isolines_context_t *ctx, const struct batch_job_t *job, int field_id,
+                   int *col0, int *col1)
+{
+  int cell_col_count = ctx->batch_fields[field_id].col_count - 1;
+
+  *col0 = job->col0;
+  *col1 = (job->col1 < cell_col_count) ? job->col1 : cell_col_count;
+}
+
+/* first pass; counts the segments of every level of every field of the job */
+static void
+run_batch_count_job(void *args, int job_id, int thread_id)
+{
+  struct isolines_context_t *ctx = args;
+  struct batch_job_t *job = &ctx->batch_jobs[job_id];
+  const struct isolines_field_t *field;
+  uint8_t *state_masks = &ctx->batch_state_masks[job->first_state_mask];
+  int slot = job->first_slot, col0, col1;
+
+  for(int i = job->first_field; i < job->first_field + job->field_count; i++)
+  {
+    field = &ctx->batch_fields[i];
+    get_batch_job_cols(ctx, job, i, &col0, &col1);
+
+    for(int j = 0; j < field->threshold_count; j++)
+    {
+      ctx->batch_slot_counts[slot++] = count_field_segments(field, field->thresholds[j], 
+                                                            col0, col1, state_masks);
+      state_masks += get_field_state_mask_count(field, col0, col1);
+    }
+  }
+}
+
+/* second pass; extracts every level of every field of the job directly into its place in the 
+ * batch */
+static void
+run_batch_fill_job(void *args, int job_id, int thread_id)
+{
+  struct isolines_context_t *ctx = args;
+  struct batch_job_t *job = &ctx->batch_jobs[job_id];
+  const struct isolines_field_t *field;
+  const uint8_t *state_masks = &ctx->batch_state_masks[job->first_state_mask];
+  GLfloat *components;
+  int slot = job->first_slot, col0, col1, component_count;
+
+  for(int i = job->first_field; i < job->first_field + job->field_count; i++)
+  {
+    field = &ctx->batch_fields[i];
+    get_batch_job_cols(ctx, job, i, &col0, &col1);
+    if(get_field_state_mask_count(field, col0, col1) == 0)
+    {
+      slot += field->threshold_count;
+      continue;
+    }
+
+    ctx->batch_edge_points[thread_id] = xreserve(ctx->batch_edge_points[thread_id], 
+                                                 &ctx->batch_edge_point_capacities[thread_id],
+                                                 2 * (field->row_count - 1), sizeof(float));
+
+    for(int j = 0; j < field->threshold_count; j++, slot++)
+    {
+      components = &ctx->batch->components[ctx->batch_slot_offsets[slot]];
+      component_count = generate_field_segments(field, field->thresholds[j], col0, col1, 
+                                                state_masks, ctx->batch_edge_points[thread_id],
+                                                components);
+      state_masks += get_field_state_mask_count(field, col0, col1);
+
+      /* the count must be exact or the jobs' outputs would overlap or leave gaps */
+      assert(component_count == ctx->batch_slot_counts[slot] * 4);
+      (void)component_count;
+    }
+  }
+}
+
+/* lays the state masks of the jobs out one after the other, each job's in the order its count 
+ * pass visits its cells; returns the total count */
+static int
+place_batch_state_masks(struct isolines_context_t *ctx)
+{
+  const struct isolines_field_t *field;
+  struct batch_job_t *job;
+  int state_mask_count = 0, col0, col1;
+
+  for(int i = 0; i < ctx->batch_job_count; i++)
+  {
+    job = &ctx->batch_jobs[i];
+    job->first_state_mask = state_mask_count;
+    for(int j = job->first_field; j < job->first_field + job->field_count; j++)
+    {
+      field = &ctx->batch_fields[j];
+      get_batch_job_cols(ctx, job, j, &col0, &col1);
+      state_mask_count += get_field_state_mask_count(field, col0, col1) * field->threshold_count;
+    }
+  }
+
+  return state_mask_count;
+}
+
+/* lays the slots of the jobs out in the batch in the order field, then level, then strip of 
+ * columns, by an exclusive prefix sum over their counts; the jobs of a field split into strips
+ * are adjacent, so their slots of each level are interleaved. Returns the component count. */
+static int
+place_batch_slots(struct isolines_context_t *ctx)
+{
+  struct isolines_batch_t *batch = ctx->batch;
+  struct batch_job_t *jobs = ctx->batch_jobs;
+  int component_count = 0, next, slot;
+
+  for(int i = 0; i < ctx->batch_job_count; i = next)
+  {
+    for(next = i + 1; next < ctx->batch_job_count; next++)
+      if(jobs[next].first_field != jobs[i].first_field)
+        break;
+
+    for(int field_id = jobs[i].first_field; 
+        field_id < jobs[i].first_field + jobs[i].field_count; 
+        field_id++)
+    {
+      for(int level = batch->field_levels[field_id]; 
+          level < batch->field_levels[field_id + 1]; 
+          level++)
+      {
+        batch->level_offsets[level] = component_count;
+        for(int j = i; j < next; j++)
+        {
+          slot = jobs[j].first_slot + (level - batch->field_levels[jobs[j].first_field]);
+          ctx->batch_slot_offsets[slot] = component_count;
+          component_count += ctx->batch_slot_counts[slot] * 4;
+        }
+      }
+    }
+  }
+
+  batch->level_offsets[batch->level_count] = component_count;
+
+  return component_count;
+}
+
+/*** COMPONENTS **********************************************************************************/
+
+/* the first sample column of a strip of the labelling; a strip owns the samples of the columns
+ * [get_component_strip_col(strip), get_component_strip_col(strip + 1)), so the last strip with
+ * any columns owns the last column of samples */
+static int
+get_component_strip_col(int strip)
+{
+  int col = strip * COMPONENT_STRIP_WIDTH;
+
+  return (col < SAMPLE_GRID_COL_COUNT - 1) ? col : SAMPLE_GRID_COL_COUNT;
+}
+
+/* the threshold and the sample columns [col0, col1) of a job of the labelling */
+static int
+get_component_job_cols(int job_id, int *col0, int *col1)
+{
+  *col0 = get_component_strip_col(job_id % ISOLINES_STRIP_COUNT);
+  *col1 = get_component_strip_col((job_id % ISOLINES_STRIP_COUNT) + 1);
+
+  return job_id / ISOLINES_STRIP_COUNT;
+}
+
+static uint8_t
+get_grid_cell_state_mask(struct isolines_context_t *ctx, int col, int row, float threshold)
+{
+  float weights[4];
+
+  weights[CELL_WEIGHT_BL] = ctx->grid.samples[col    ][row    ].weight;
+  weights[CELL_WEIGHT_BR] = ctx->grid.samples[col + 1][row    ].weight;
+  weights[CELL_WEIGHT_TR] = ctx->grid.samples[col + 1][row + 1].weight;
+  weights[CELL_WEIGHT_TL] = ctx->grid.samples[col    ][row + 1].weight;
+
+  return get_cell_state_mask(weights, threshold);
+}
+
+/* the sample index of each corner of the cell, in the order of the bits of the state mask */
+static void
+get_cell_corner_samples(int col, int row, int samples[4])
+{
+  samples[0] = ( col      * SAMPLE_GRID_ROW_COUNT) + row;
+  samples[1] = ((col + 1) * SAMPLE_GRID_ROW_COUNT) + row;
+  samples[2] = ((col + 1) * SAMPLE_GRID_ROW_COUNT) + row + 1;
+  samples[3] = ( col      * SAMPLE_GRID_ROW_COUNT) + row + 1;
+}
+
+/* the root of the set of the sample; halves the path to it on the way */
+static int
+find_component_root(int *parents, int sample)
+{
+  while(parents[sample] != sample)
+  {
+    parents[sample] = parents[parents[sample]];
+    sample = parents[sample];
+  }
+
+  return sample;
+}
+
+/* as 'find_component_root' but writes nothing, so the forest can be read by many jobs at once */
+static int
+peek_component_root(const int *parents, int sample)
+{
+  while(parents[sample] != sample)
+    sample = parents[sample];
+
+  return sample;
+}
+
+static void
+join_components(int *parents, int sample, int other_sample)
+{
+  int root = find_component_root(parents, sample);
+  int other_root = find_component_root(parents, other_sample);
+
+  if(root < other_root)
+    parents[other_root] = root;
+  else if(other_root < root)
+    parents[root] = other_root;
+}
+
+/* joins the corners of the cell at or above the threshold */
+static void
+join_cell_components(int *parents, int col, int row, uint8_t state_mask)
+{
+  int samples[4], first = COMPONENT_NULL;
+
+  get_cell_corner_samples(col, row, samples);
+  for(int i = 0; i < 4; i++)
+  {
+    if(!(state_mask & (1 << i)))
+      continue;
+
+    if(first == COMPONENT_NULL)
+      first = samples[i];
+    else
+      join_components(parents, first, samples[i]);
+  }
+}
+
+/* the area of the part of the cell at or above the threshold (unit: cells); the area of the
+ * polygon of its corners at or above the threshold and the points the isolines cross its edges
+ * at, each lerped from the bottom/left sample of its edge as in the extraction */
+static double
+get_cell_component_area(struct isolines_context_t *ctx, int col, int row, uint8_t state_mask,
+                        float threshold)
+{
+  /* the corners anticlockwise from the bottom-left, in the order of the bits of the state mask */
+  static const float corners[4][2] = {{0.f, 0.f}, {1.f, 0.f}, {1.f, 1.f}, {0.f, 1.f}};
+
+  struct point2d_t points[8];
+  float w[4], offset;
+  double area2 = 0.0;
+  int point_count = 0, next;
+
+  if(state_mask == 0b1111)
+    return 1.0;
+
+  w[0] = ctx->grid.samples[col    ][row    ].weight;
+  w[1] = ctx->grid.samples[col + 1][row    ].weight;
+  w[2] = ctx->grid.samples[col + 1][row + 1].weight;
+  w[3] = ctx->grid.samples[col    ][row + 1].weight;
+
+  for(int i = 0; i < 4; i++)
+  {
+    if(state_mask & (1 << i))
+      points[point_count++] = (struct point2d_t){corners[i][0], corners[i][1]};
+
+    next = (i + 1) % 4;
+    if(((state_mask >> i) & 1) == ((state_mask >> next) & 1))
+      continue;
+
+    switch(i)
+    {
+    case 0: /* bottom */
+      offset = (threshold - w[0]) / (w[1] - w[0]);
+      points[point_count++] = (struct point2d_t){offset, 0.f};
+      break;
+    case 1: /* right */
+      offset = (threshold - w[1]) / (w[2] - w[1]);
+      points[point_count++] = (struct point2d_t){1.f, offset};
+      break;
+    case 2: /* top */
+      offset = (threshold - w[3]) / (w[2] - w[3]);
+      points[point_count++] = (struct point2d_t){offset, 1.f};
+      break;
+    case 3: /* left */
+      offset = (threshold - w[0]) / (w[3] - w[0]);
+      points[point_count++] = (struct point2d_t){0.f, offset};
+      break;
+    }
+  }
+
+  for(int i = 0; i < point_count; i++)
+  {
+    next = (i + 1) % point_count;
+    area2 += ((double)points[i].x * points[next].y) - ((double)points[next].x * points[i].y);
+  }
+
+  return area2 * 0.5;
+}
+
+/* first pass; joins the samples of the strip of the job through the cells within it */
+static void
+run_component_label_job(void *args, int job_id, int thread_id)
+{
+  struct isolines_context_t *ctx = args;
+  int col0, col1, threshold_id, sample;
+  int *parents;
+  float threshold;
+
+  threshold_id = get_component_job_cols(job_id, &col0, &col1);
+  threshold = ctx->thresholds[threshold_id];
+  parents = ctx->component_parents[threshold_id];
+
+  for(int col = col0; col < col1; col++)
+  {
+    for(int row = 0; row < SAMPLE_GRID_ROW_COUNT; row++)
+    {
+      sample = (col * SAMPLE_GRID_ROW_COUNT) + row;
+      parents[sample] = (ctx->grid.samples[col][row].weight >= threshold) ? sample :
+                                                                            COMPONENT_NULL;
+    }
+  }
+
+  for(int col = col0; col < col1 - 1; col++)
+    for(int row = 0; row < SAMPLE_GRID_ROW_COUNT - 1; row++)
+      join_cell_components(parents, col, row,
+                           get_grid_cell_state_mask(ctx, col, row, threshold));
+}
+
+/* joins the samples of the threshold through the cells of the seams between the strips */
+static void
+join_component_seams(struct isolines_context_t *ctx, int threshold_id)
+{
+  float threshold = ctx->thresholds[threshold_id];
+  int col;
+
+  for(int strip = 1; strip < ISOLINES_STRIP_COUNT; strip++)
+  {
+    col = get_component_strip_col(strip) - 1;
+    if(col >= SAMPLE_GRID_COL_COUNT - 1)
+      break;
+
+    for(int row = 0; row < SAMPLE_GRID_ROW_COUNT - 1; row++)
+      join_cell_components(ctx->component_parents[threshold_id], col, row,
+                           get_grid_cell_state_mask(ctx, col, row, threshold));
+  }
+}
+
+/* second pass; counts the roots in the strip of the job */
+static void
+run_component_count_job(void *args, int job_id, int thread_id)
+{
+  struct isolines_context_t *ctx = args;
+  int col0, col1, threshold_id, root_count = 0;
+  const int *parents;
+
+  threshold_id = get_component_job_cols(job_id, &col0, &col1);
+  parents = ctx->component_parents[threshold_id];
+
+  for(int sample = col0 * SAMPLE_GRID_ROW_COUNT; sample < col1 * SAMPLE_GRID_ROW_COUNT; sample++)
+    root_count += (parents[sample] == sample) ? 1 : 0;
+
+  ctx->job_component_counts[job_id] = root_count;
+}
+
+/* third pass; numbers the roots in the strip of the job from the job's offset */
+static void
+run_component_id_job(void *args, int job_id, int thread_id)
+{
+  struct isolines_context_t *ctx = args;
+  int col0, col1, threshold_id, id;
+  const int *parents;
+
+  threshold_id = get_component_job_cols(job_id, &col0, &col1);
+  parents = ctx->component_parents[threshold_id];
+  id = ctx->job_component_offsets[job_id];
+
+  for(int sample = col0 * SAMPLE_GRID_ROW_COUNT; sample < col1 * SAMPLE_GRID_ROW_COUNT; sample++)
+    if(parents[sample] == sample)
+      ctx->component_root_ids[threshold_id][sample] = id++;
+}
+
+/* last pass; labels the cells whose left corners are in the strip of the job, and sums them by
+ * region into the job's own sums */
+static void
+run_component_cell_job(void *args, int job_id, int thread_id)
+{
+  struct isolines_context_t *ctx = args;
+  struct component_sums_t *sums;
+  int col0, col1, threshold_id, component_count, samples[4], corner, label;
+  const int *parents;
+  float threshold;
+  uint8_t state_mask;
+
+  threshold_id = get_component_job_cols(job_id, &col0, &col1);
+  threshold = ctx->thresholds[threshold_id];
+  parents = ctx->component_parents[threshold_id];
+  component_count = ctx->component_threshold_offsets[threshold_id + 1] -
+                    ctx->component_threshold_offsets[threshold_id];
+
+  ctx->job_component_sums[job_id] = xreserve(ctx->job_component_sums[job_id],
+                                             &ctx->job_component_sum_capacities[job_id],
+                                             component_count, sizeof(struct component_sums_t));
+  sums = ctx->job_component_sums[job_id];
+  memset((void *)sums, 0, sizeof(struct component_sums_t) * component_count);
+
+  col1 = (col1 < SAMPLE_GRID_COL_COUNT - 1) ? col1 : SAMPLE_GRID_COL_COUNT - 1;
+  for(int col = col0; col < col1; col++)
+  {
+    for(int row = 0; row < SAMPLE_GRID_ROW_COUNT - 1; row++)
+    {
+      state_mask = get_grid_cell_state_mask(ctx, col, row, threshold);
+      label = COMPONENT_NULL;
+      if(state_mask != 0)
+      {
+        /* any corner at or above the threshold will do; they are all in the same region */
+        get_cell_corner_samples(col, row, samples);
+        corner = 0;
+        while(!(state_mask & (1 << corner)))
+          ++corner;
+        label = ctx->component_root_ids[threshold_id][peek_component_root(parents, 
+                                                                          samples[corner])];
+
+        sums[label].area += get_cell_component_area(ctx, col, row, state_mask, threshold);
+        ++sums[label].cell_count;
+      }
+
+      ctx->component_labels[threshold_id][(col * (SAMPLE_GRID_ROW_COUNT - 1)) + row] = label;
+    }
+  }
+}
+
+/*** SEGMENT INDEX *******************************************************************************/
+
+/* the bin of a grid space point; a point beyond the grid is clamped into the bins of its border */
+static void
+get_segment_bin(struct point2d_t point, int *col, int *row)
+{
+  *col = (int)fminf(fmaxf(point.x / CELL_SIZE_M, 0.f), (float)(SEGMENT_BIN_COL_COUNT - 1));
+  *row = (int)fminf(fmaxf(point.y / CELL_SIZE_M, 0.f), (float)(SEGMENT_BIN_ROW_COUNT - 1));
+}
+
+/* bins the segments of the isolines mesh; only done once the mesh has changed */
+static void
+build_segment_index(struct isolines_context_t *ctx)
+{
+  const float *components, *segment;
+  int segment_count, col, row, bin;
+  float dx, dy;
+
+  if(ctx->is_segment_index_built)
+    return;
+
+  segment_count = get_isolines_mesh_r(ctx, &components) / 4;
+
+  ctx->segment_bins = xreserve(ctx->segment_bins, &ctx->segment_bin_capacity, segment_count, 
+                               sizeof(int));
+  ctx->binned_segments = xreserve(ctx->binned_segments, &ctx->binned_segment_capacity, 
+                                  segment_count, sizeof(int));
+  memset((void *)ctx->segment_bin_offsets, 0, sizeof(int) * (SEGMENT_BIN_COUNT + 1));
+  ctx->segment_reach_m = 0.f;
+
+  for(int i = 0; i < segment_count; i++)
+  {
+    segment = &components[i * 4];
+    get_segment_bin((struct point2d_t){(segment[0] + segment[2]) * 0.5f, 
+                                       (segment[1] + segment[3]) * 0.5f}, &col, &row);
+    bin = (col * SEGMENT_BIN_ROW_COUNT) + row;
+    ctx->segment_bins[i] = bin;
+    ++ctx->segment_bin_offsets[bin];
+
+    dx = segment[2] - segment[0];
+    dy = segment[3] - segment[1];
+    ctx->segment_reach_m = fmaxf(ctx->segment_reach_m, 0.5f * sqrtf((dx * dx) + (dy * dy)));
+  }
+
+  /* the offsets are summed to the end of each bin, then the segments are placed back to front so
+   * each offset ends at the start of its bin, and the segments of a bin are in mesh order */
+  for(int i = 1; i <= SEGMENT_BIN_COUNT; i++)
+    ctx->segment_bin_offsets[i] += ctx->segment_bin_offsets[i - 1];
+  for(int i = segment_count - 1; i >= 0; i--)
+    ctx->binned_segments[--ctx->segment_bin_offsets[ctx->segment_bins[i]]] = i;
+
+  ctx->indexed_mesh = components;
+  ctx->is_segment_index_built = true;
+}
+
+/* the squared distance from a point to a segment {x0, y0, x1, y1}, and the closest point of the
+ * segment to it */
+static float
+get_segment_distance2(const float *segment, struct point2d_t point, struct point2d_t *closest)
+{
+  float dx = segment[2] - segment[0];
+  float dy = segment[3] - segment[1];
+  float length2 = (dx * dx) + (dy * dy);
+  float t = 0.f;
+
+  if(length2 > 0.f)
+  {
+    t = (((point.x - segment[0]) * dx) + ((point.y - segment[1]) * dy)) / length2;
+    t = fminf(fmaxf(t, 0.f), 1.f);
+  }
+
+  closest->x = segment[0] + (t * dx);
+  closest->y = segment[1] + (t * dy);
+  dx = point.x - closest->x;
+  dy = point.y - closest->y;
+
+  return (dx * dx) + (dy * dy);
+}
+
+/* tests the segments of a bin against the nearest segment to the point so far; ties go to the 
+ * lower segment, so the hit does not depend on the order the bins are searched in */
+static void
+search_segment_bin(struct isolines_context_t *ctx, int col, int row, struct point2d_t point,
+                   struct isolines_segment_hit_t *hit, float *nearest_distance2)
+{
+  struct point2d_t closest;
+  int bin = (col * SEGMENT_BIN_ROW_COUNT) + row, segment;
+  float distance2;
+
+  for(int i = ctx->segment_bin_offsets[bin]; i < ctx->segment_bin_offsets[bin + 1]; i++)
+  {
+    segment = ctx->binned_segments[i];
+    distance2 = get_segment_distance2(&ctx->indexed_mesh[segment * 4], point, &closest);
+    if(distance2 < *nearest_distance2 || 
+       (distance2 == *nearest_distance2 && segment < hit->segment))
+    {
+      *nearest_distance2 = distance2;
+      hit->segment = segment;
+      hit->point = closest;
+    }
+  }
+}
+
+/* finds the nearest segment to a grid space point by searching the bins in rings of growing size
+ * around the bin of the point; stops once every bin outside the rings searched is further from
+ * the point, less the reach, than the nearest segment found */
+static void
+find_nearest_segment(struct isolines_context_t *ctx, struct point2d_t point, 
+                     struct isolines_segment_hit_t *hit)
+{
+  int col, row, col0, col1, row0, row1, threshold_id;
+  float nearest_distance2 = INFINITY, bound;
+
+  hit->segment = -1;
+  if(ctx->segment_bin_offsets[SEGMENT_BIN_COUNT] == 0)
+  {
+    hit->threshold_id = -1;
+    hit->distance_m = INFINITY;
+    hit->point = point;
+    return;
+  }
+
+  get_segment_bin(point, &col, &row);
+  for(int ring = 0; ; ring++)
+  {
+    col0 = col - ring;
+    col1 = col + ring;
+    row0 = row - ring;
+    row1 = row + ring;
+    for(int c = (col0 > 0) ? col0 : 0; c <= col1 && c < SEGMENT_BIN_COL_COUNT; c++)
+    {
+      /* the columns at the sides of the ring are searched whole, the others only at its top and
+       * bottom */
+      if(c == col0 || c == col1)
+      {
+        for(int r = (row0 > 0) ? row0 : 0; r <= row1 && r < SEGMENT_BIN_ROW_COUNT; r++)
+          search_segment_bin(ctx, c, r, point, hit, &nearest_distance2);
+      }
+      else
+      {
+        if(row0 >= 0)
+          search_segment_bin(ctx, c, row0, point, hit, &nearest_distance2);
+        if(row1 < SEGMENT_BIN_ROW_COUNT)
+          search_segment_bin(ctx, c, row1, point, hit, &nearest_distance2);
+      }
+    }
+
+    /* the distance from the point to the nearest bin not yet searched */
+    bound = INFINITY;
+    if(col0 > 0)
+      bound = fminf(bound, point.x - (col0 * CELL_SIZE_M));
+    if(col1 < SEGMENT_BIN_COL_COUNT - 1)
+      bound = fminf(bound, ((col1 + 1) * CELL_SIZE_M) - point.x);
+    if(row0 > 0)
+      bound = fminf(bound, point.y - (row0 * CELL_SIZE_M));
+    if(row1 < SEGMENT_BIN_ROW_COUNT - 1)
+      bound = fminf(bound, ((row1 + 1) * CELL_SIZE_M) - point.y);
+
+    if(bound == INFINITY)
+      break;
+    bound -= ctx->segment_reach_m;
+    if(hit->segment != -1 && bound > 0.f && bound * bound > nearest_distance2)
+      break;
+  }
+
+  threshold_id = 0;
+  while(ctx->isolines_mesh_level_offsets[threshold_id + 1] <= hit->segment * 4)
+    ++threshold_id;
+
+  hit->threshold_id = threshold_id;
+  hit->distance_m = sqrtf(nearest_distance2);
+}
+
+/* counts the segments within the radius of a grid space point, and writes them to 'segments' 
+ * unless it is NULL; the segments are in order of their bins, column by column */
+static int
+find_segments_in_radius(struct isolines_context_t *ctx, struct point2d_t point, float radius_m,
+                        int *segments)
+{
+  struct point2d_t closest;
+  int col0, col1, row0, row1, bin, segment, segment_count = 0;
+  float reach = radius_m + ctx->segment_reach_m;
+
+  get_segment_bin((struct point2d_t){point.x - reach, point.y - reach}, &col0, &row0);
+  get_segment_bin((struct point2d_t){point.x + reach, point.y + reach}, &col1, &row1);
+
+  for(int col = col0; col <= col1; col++)
+  {
+    for(int row = row0; row <= row1; row++)
+    {
+      bin = (col * SEGMENT_BIN_ROW_COUNT) + row;
+      for(int i = ctx->segment_bin_offsets[bin]; i < ctx->segment_bin_offsets[bin + 1]; i++)
+      {
+        segment = ctx->binned_segments[i];
+        if(get_segment_distance2(&ctx->indexed_mesh[segment * 4], point, &closest) > 
+           radius_m * radius_m)
+          continue;
+
+        if(segments != NULL)
+          segments[segment_count] = segment;
+        ++segment_count;
+      }
+    }
+  }
+
+  return segment_count;
+}
+
+/* the queries [first, last) of a job of a batch of queries */
+static void
+get_segment_query_job_range(struct isolines_context_t *ctx, int job_id, int *first, int *last)
+{
+  *first = job_id * SEGMENT_QUERY_JOB_SIZE;
+  *last = *first + SEGMENT_QUERY_JOB_SIZE;
+  *last = (*last < ctx->segment_query_count) ? *last : ctx->segment_query_count;
+}
+
+static void
+run_segment_nearest_job(void *args, int job_id, int thread_id)
+{
+  struct isolines_context_t *ctx = args;
+  struct isolines_segment_hit_t *hit;
+  int first, last;
+
+  get_segment_query_job_range(ctx, job_id, &first, &last);
+  for(int i = first; i < last; i++)
+  {
+    hit = &ctx->segment_hits[i];
+    find_nearest_segment(ctx, ctx->segment_queries[i], hit);
+    hit->point.x += ctx->grid.pos_w_m.x;
+    hit->point.y += ctx->grid.pos_w_m.y;
+  }
+}
+
+/* first pass of a radius query; counts the segments of each query */
+static void
+run_segment_radius_count_job(void *args, int job_id, int thread_id)
+{
+  struct isolines_context_t *ctx = args;
+  int first, last;
+
+  get_segment_query_job_range(ctx, job_id, &first, &last);
+  for(int i = first; i < last; i++)
+    ctx->segment_query_offsets[i + 1] = find_segments_in_radius(ctx, ctx->segment_queries[i], 
+                                                                ctx->segment_query_radius_m, 
+                                                                NULL);
+}
+
+/* second pass of a radius query; writes the segments of each query from its offset */
+static void
+run_segment_radius_fill_job(void *args, int job_id, int thread_id)
+{
+  struct isolines_context_t *ctx = args;
+  int first, last;
+
+  get_segment_query_job_range(ctx, job_id, &first, &last);
+  for(int i = first; i < last; i++)
+    find_segments_in_radius(ctx, ctx->segment_queries[i], ctx->segment_query_radius_m, 
+                            &ctx->found_segments[ctx->segment_query_offsets[i]]);
+}
+
+/* indexes the mesh (if needed) and copies a batch of world space query points into grid space; 
+ * returns the job count of the batch */
+static int
+begin_segment_queries(struct isolines_context_t *ctx, const struct point2d_t *points_w_m, 
+                      int point_count)
+{
+  build_segment_index(ctx);
+
+  ctx->segment_queries = xreserve(ctx->segment_queries, &ctx->segment_query_capacity, 
+                                  point_count, sizeof(struct point2d_t));
+  for(int i = 0; i < point_count; i++)
+  {
+    ctx->segment_queries[i].x = points_w_m[i].x - ctx->grid.pos_w_m.x;
+    ctx->segment_queries[i].y = points_w_m[i].y - ctx->grid.pos_w_m.y;
+  }
+  ctx->segment_query_count = point_count;
+
+  return (point_count + SEGMENT_QUERY_JOB_SIZE - 1) / SEGMENT_QUERY_JOB_SIZE;
+}
+
+/*** MODULE INTERFACE  ***************************************************************************/
+
+struct isolines_context_t *
+create_isolines_context(struct point2d_t grid_pos_w_m)
+{
+  static const float default_thresholds[THRESHOLD_COUNT] = {0.6f, 0.8f, 1.f, 1.3f, 2.f};
+
+  struct isolines_context_t *ctx = xmalloc(sizeof(struct isolines_context_t));
+
+  memset((void *)ctx, 0, sizeof(struct isolines_context_t));
+  memcpy((void *)ctx->thresholds, (void *)default_thresholds, sizeof(float) * THRESHOLD_COUNT);
+
+  ctx->isolines_mesh = (struct mesh_chunk_t){
+    NULL, 0, 0, ISOLINES_USE_MESH_SLABS ? MESH_CHUNK_SLABS : MESH_CHUNK_REALLOC, 
+    &ctx->isolines_mesh_slabs
+  };
+  ctx->compacted_isolines_mesh = (struct mesh_chunk_t){NULL, 0, 0, MESH_CHUNK_REALLOC, NULL};
+  pthread_mutex_init(&ctx->free_slabs_mutex, NULL);
+
+  ctx->lod_stride = 1;
+  ctx->isolines_mesh_stride = 1;
+  ctx->isolines_mesh_region = whole_grid_region;
+
+  /* mixing in the address keeps contexts created within the same second apart */
+  ctx->rand_seed = (unsigned int)time(NULL) ^ (unsigned int)(uintptr_t)ctx;
+
+  init_grid(ctx, grid_pos_w_m);
+  init_sample_gfx_data(ctx);
+  pool_init(&ctx->isolines_pool, ISOLINES_THREAD_COUNT);
+  for(int tile_col = 0; tile_col < PYRAMID_TILE_COL_COUNT; tile_col++)
+    for(int tile_row = 0; tile_row < PYRAMID_TILE_ROW_COUNT; tile_row++)
+      ctx->tile_meshes[tile_col][tile_row].growth = MESH_CHUNK_REALLOC;
+  invalidate_tile_meshes(ctx);
+  clock_init(&ctx->remesh_clock, CLOCK_MONOTONIC);
+  generate_glob_mesh(ctx);
+  generate_globs(ctx);
+
+  return ctx;
+}
+
+void
+destroy_isolines_context(struct isolines_context_t *ctx)
+{
+  struct isolines_mesh_slab_t *slab;
+
+  pool_destroy(&ctx->isolines_pool);
+
+  release_slab_mesh(ctx, &ctx->isolines_mesh_slabs);
+  for(int i = 0; i < ISOLINES_JOB_COUNT; i++)
+    release_slab_mesh(ctx, &ctx->job_slab_meshes[i]);
+  while((slab = ctx->free_slabs) != NULL)
+  {
+    ctx->free_slabs = slab->next;
+    free(slab);
+  }
+
+  /* a mesh built in slabs writes into (and so does not own) the tail slab */
+  if(ctx->isolines_mesh.growth == MESH_CHUNK_REALLOC)
+    free(ctx->isolines_mesh.components);
+  free(ctx->compacted_isolines_mesh.components);
+  for(int tile_col = 0; tile_col < PYRAMID_TILE_COL_COUNT; tile_col++)
+    for(int tile_row = 0; tile_row < PYRAMID_TILE_ROW_COUNT; tile_row++)
+      free(ctx->tile_meshes[tile_col][tile_row].components);
+
+  free(ctx->isolines_polyline_mesh);
+  free(ctx->isolines_polylines);
+  for(int i = 0; i < ISOLINES_THREAD_COUNT; i++)
+  {
+    free(ctx->simplify_scratches[i].stack);
+    free(ctx->simplify_scratches[i].is_kept);
+  }
+  free(ctx->prev_trace_seeds);
+  free(ctx->trace_seeds);
+  free(ctx->nesting_crossings);
+  free(ctx->sorted_nesting_crossings);
+  free(ctx->nesting_stack);
+
+  free(ctx->isoband_vertices);
+  for(int i = 0; i < BAND_COUNT; i++)
+    free(ctx->isoband_indices[i]);
+
+  free(ctx->dual_vertices);
+  free(ctx->dual_indices);
+
+  for(int i = 0; i < ctx->raster_tile_capacity; i++)
+  {
+    free(ctx->raster_tiles[i].vertices);
+    free(ctx->raster_tiles[i].pieces);
+  }
+  free(ctx->raster_tiles);
+  for(int i = 0; i < ISOLINES_THREAD_COUNT; i++)
+  {
+    free(ctx->raster_scratches[i].weights);
+    free(ctx->raster_scratches[i].edge_vertex_ids);
+    free(ctx->raster_scratches[i].vertices);
+    free(ctx->raster_scratches[i].vertex_keys);
+  }
+  free(ctx->raster_seams);
+  free(ctx->raster_threshold_offsets);
+
+  free(ctx->batch_jobs);
+  free(ctx->batch_slot_counts);
+  free(ctx->batch_slot_offsets);
+  free(ctx->batch_state_masks);
+  for(int i = 0; i < ISOLINES_THREAD_COUNT; i++)
+    free(ctx->batch_edge_points[i]);
+
+  free(ctx->components);
+  for(int i = 0; i < ISOLINES_JOB_COUNT; i++)
+    free(ctx->job_component_sums[i]);
+
+  free(ctx->segment_bins);
+  free(ctx->binned_segments);
+  free(ctx->segment_queries);
+  free(ctx->segment_query_offsets);
+  free(ctx->found_segments);
+
+  pthread_mutex_destroy(&ctx->free_slabs_mutex);
+  free(ctx);
+}
+
+void
+tick_isolines_r(struct isolines_context_t *ctx)
+{
+  /* the level of detail and culling apply only to the segments extracted from a moving field; a
+   * frozen field has been evaluated (and indexed) in full */
+  bool is_lod_mode = (ctx->extraction_mode == ISOLINES_EXTRACT_SEGMENTS && !ctx->is_field_frozen);
+  int stride = is_lod_mode ? ctx->lod_stride : 1;
+
+  ctx->isolines_mesh_region = whole_grid_region;
+  if(is_lod_mode && ctx->is_view_culled)
+  {
+    ++ctx->view_refresh_tick;
+    if(ISOLINES_VIEW_REFRESH_TICKS == 0 || 
+       ctx->view_refresh_tick % ISOLINES_VIEW_REFRESH_TICKS != 0)
+      get_view_region(ctx, stride, &ctx->isolines_mesh_region);
+  }
+
+  /* a frozen field does not change; only the extraction is repeated since the thresholds may 
+   * have changed */
+  if(!ctx->is_field_frozen)
+  {
+    tick_globs(ctx);
+
+    /* when tracing (or refining adaptively) the samples are evaluated on demand, only in the 
+     * cells the tracer walks through (or the leaves of the quadtree); moving to the next tick 
+     * stamp invalidates all previously evaluated samples */
+    if(ctx->extraction_mode == ISOLINES_EXTRACT_TRACE || 
+       ctx->extraction_mode == ISOLINES_EXTRACT_ADAPTIVE)
+      ++ctx->tick_stamp;
+    else
+      tick_grid(ctx, stride, &ctx->isolines_mesh_region);
+  }
+
+  ctx->isolines_mesh_stride = stride;
+
+  /* the segment index is rebuilt from the new mesh by the first query after the tick */
+  ctx->is_segment_index_built = false;
+
+  switch(ctx->extraction_mode)
+  {
+  case ISOLINES_EXTRACT_SEGMENTS:
+    reset_isolines_mesh(ctx);
+    if(ctx->is_field_frozen)
+    {
+      for(int i = 0; i < THRESHOLD_COUNT; ++i)
+      {
+        begin_isolines_mesh_level(ctx, i);
+        generate_isolines_mesh_from_span_index(ctx, ctx->thresholds[i]);
+      }
+    }
+    else if(stride > 1)
+    {
+      /* a coarse lattice has few enough cells to extract serially */
+      for(int i = 0; i < THRESHOLD_COUNT; ++i)
+      {
+        begin_isolines_mesh_level(ctx, i);
+        generate_isolines_mesh(ctx, ctx->thresholds[i], stride, &ctx->isolines_mesh_region);
+      }
+    }
+    else if(ISOLINES_THREAD_COUNT > 1 && ISOLINES_USE_MESH_SLABS)
+      generate_isolines_mesh_parallel_slabs(ctx);
+    else if(ISOLINES_THREAD_COUNT > 1)
+      generate_isolines_mesh_parallel(ctx);
+    else
+    {
+      for(int i = 0; i < THRESHOLD_COUNT; ++i)
+      {
+        begin_isolines_mesh_level(ctx, i);
+        generate_isolines_mesh(ctx, ctx->thresholds[i], 1, &ctx->isolines_mesh_region);
+      }
+    }
+    finish_isolines_mesh(ctx);
+    break;
+  case ISOLINES_EXTRACT_POLYLINES:
+    reset_isolines_polylines(ctx);
+    for(int i = 0; i < THRESHOLD_COUNT; ++i)
+    {
+      generate_isolines_polylines(ctx, i);
+      if(ISOLINES_SIMPLIFY_TOLERANCE_M > 0.f)
+        simplify_isolines_polylines(ctx, i);
+    }
+    nest_isolines_polylines(ctx);
+    break;
+  case ISOLINES_EXTRACT_TRACE:
+    reset_isolines_polylines(ctx);
+    begin_trace_isolines(ctx);
+    for(int i = 0; i < THRESHOLD_COUNT; ++i)
+    {
+      trace_isolines(ctx, i);
+      if(ISOLINES_SIMPLIFY_TOLERANCE_M > 0.f)
+        simplify_isolines_polylines(ctx, i);
+    }
+    nest_isolines_polylines(ctx);
+    break;
+  case ISOLINES_EXTRACT_INCREMENTAL:
+    remesh_isolines_incremental(ctx);
+    break;
+  case ISOLINES_EXTRACT_BANDS:
+    reset_isobands(ctx);
+    generate_isobands(ctx);
+    break;
+  case ISOLINES_EXTRACT_DUAL:
+    reset_isolines_dual(ctx);
+    for(int i = 0; i < THRESHOLD_COUNT; ++i)
+      generate_isolines_dual(ctx, i);
+    break;
+  case ISOLINES_EXTRACT_ADAPTIVE:
+    reset_isolines_mesh(ctx);
+    generate_isolines_mesh_adaptive(ctx);
+    finish_isolines_mesh(ctx);
+    break;
+  default:
+    assert(0);
+  }
+}
+
+void
+draw_isolines_r(struct isolines_context_t *ctx)
+{
+  glPushMatrix();
+  glTranslatef(ctx->grid.pos_w_m.x, ctx->grid.pos_w_m.y, 0.f);
+
+  draw_samples(ctx);
+  if(ctx->extraction_mode == ISOLINES_EXTRACT_POLYLINES || 
+     ctx->extraction_mode == ISOLINES_EXTRACT_TRACE)
+    draw_isolines_polylines(ctx);
+  else if(ctx->extraction_mode == ISOLINES_EXTRACT_BANDS)
+    draw_isobands(ctx);
+  else if(ctx->extraction_mode == ISOLINES_EXTRACT_DUAL)
+    draw_isolines_dual(ctx);
+  else
+    draw_isolines_mesh(ctx);
+  draw_globs(ctx);
+
+  glPopMatrix();
+}
+
+void
+set_isolines_extraction_mode_r(struct isolines_context_t *ctx, 
+                               enum isolines_extraction_mode_t mode)
+{
+  assert(0 <= mode && mode < ISOLINES_EXTRACTION_MODE_COUNT);
+  ctx->extraction_mode = mode;
+
+  /* the tile meshes are not maintained in other modes */
+  invalidate_tile_meshes(ctx);
+  ctx->is_isolines_mesh_compacted = false;
+  ctx->is_segment_index_built = false;
+}
+
+enum isolines_extraction_mode_t
+get_isolines_extraction_mode_r(struct isolines_context_t *ctx)
+{
+  return ctx->extraction_mode;
+}
+
+int
+get_isolines_polylines_r(struct isolines_context_t *ctx, int threshold_id, 
+                         const struct isoline_polyline_t **polylines, 
+                         const float **vertices)
+{
+  assert(0 <= threshold_id && threshold_id < THRESHOLD_COUNT);
+  assert(ctx->extraction_mode == ISOLINES_EXTRACT_POLYLINES || 
+         ctx->extraction_mode == ISOLINES_EXTRACT_TRACE);
+
+  *polylines = &ctx->isolines_polylines[ctx->isolines_polyline_threshold_offsets[threshold_id]];
+  *vertices = ctx->isolines_polyline_mesh;
+
+  return ctx->isolines_polyline_threshold_offsets[threshold_id + 1] - 
+         ctx->isolines_polyline_threshold_offsets[threshold_id];
+}
+
+void
+set_isolines_field_frozen_r(struct isolines_context_t *ctx, bool is_frozen)
+{
+  if(is_frozen && !ctx->is_field_frozen)
+  {
+    /* the samples may have been only partially evaluated (when tracing or refining 
+     * adaptively), so evaluate the whole field once more before indexing it */
+    tick_grid(ctx, 1, &whole_grid_region);
+    build_span_index(ctx);
+  }
+
+  ctx->is_field_frozen = is_frozen;
+}
+
+bool
+is_isolines_field_frozen_r(struct isolines_context_t *ctx)
+{
+  return ctx->is_field_frozen;
+}
+
+void
+shift_isolines_thresholds_r(struct isolines_context_t *ctx, float delta)
+{
+  for(int i = 0; i < THRESHOLD_COUNT; ++i)
+    ctx->thresholds[i] += delta;
+
+  invalidate_tile_meshes(ctx);
+}
+
+void
+set_isolines_pixel_size_r(struct isolines_context_t *ctx, float pixel_size_m)
+{
+  ctx->lod_stride = 1;
+  while(ctx->lod_stride < ISOLINES_LOD_MAX_STRIDE && 
+        (ctx->lod_stride * CELL_SIZE_M) < (ISOLINES_LOD_MIN_CELL_PX * pixel_size_m))
+    ctx->lod_stride *= 2;
+}
+
+void
+set_isolines_view_rect_r(struct isolines_context_t *ctx, struct point2d_t min_w_m,
+                         struct point2d_t max_w_m)
+{
+  ctx->view_min_g_m.x = min_w_m.x - ctx->grid.pos_w_m.x;
+  ctx->view_min_g_m.y = min_w_m.y - ctx->grid.pos_w_m.y;
+  ctx->view_max_g_m.x = max_w_m.x - ctx->grid.pos_w_m.x;
+  ctx->view_max_g_m.y = max_w_m.y - ctx->grid.pos_w_m.y;
+  ctx->is_view_culled = true;
+}
+
+void
+clear_isolines_view_rect_r(struct isolines_context_t *ctx)
+{
+  ctx->is_view_culled = false;
+}
+
+void
+set_isolines_focus_r(struct isolines_context_t *ctx, struct point2d_t focus_w_m)
+{
+  ctx->remesh_focus_g_m.x = focus_w_m.x - ctx->grid.pos_w_m.x;
+  ctx->remesh_focus_g_m.y = focus_w_m.y - ctx->grid.pos_w_m.y;
+}
+
+int
+get_isolines_mesh_r(struct isolines_context_t *ctx, const float **components)
+{
+  assert(ctx->extraction_mode == ISOLINES_EXTRACT_SEGMENTS || 
+         ctx->extraction_mode == ISOLINES_EXTRACT_INCREMENTAL || 
+         ctx->extraction_mode == ISOLINES_EXTRACT_ADAPTIVE);
+
+  if(ISOLINES_USE_MESH_SLABS || ctx->extraction_mode == ISOLINES_EXTRACT_INCREMENTAL)
+  {
+    compact_isolines_mesh(ctx);
+    *components = ctx->compacted_isolines_mesh.components;
+    return ctx->compacted_isolines_mesh.component_count;
+  }
+
+  *components = ctx->isolines_mesh.components;
+  return ctx->isolines_mesh.component_count;
+}
+
+int
+get_isolines_mesh_level_r(struct isolines_context_t *ctx, int threshold_id,
+                          const float **components)
+{
+  assert(0 <= threshold_id && threshold_id < THRESHOLD_COUNT);
+
+  /* ensures the mesh is contiguous (and the tile meshes ordered by level) */
+  get_isolines_mesh_r(ctx, components);
+
+  *components += ctx->isolines_mesh_level_offsets[threshold_id];
+
+  return ctx->isolines_mesh_level_offsets[threshold_id + 1] - 
+         ctx->isolines_mesh_level_offsets[threshold_id];
+}
+
+const struct isolines_mesh_slab_t *
+get_isolines_mesh_slabs_r(struct isolines_context_t *ctx)
+{
+  assert(ctx->extraction_mode == ISOLINES_EXTRACT_SEGMENTS || 
+         ctx->extraction_mode == ISOLINES_EXTRACT_ADAPTIVE);
+
+  return ctx->isolines_mesh_slabs.head;
+}
+
+int
+get_isolines_bands_r(struct isolines_context_t *ctx, int band_id, const unsigned int **indices,
+                     const float **vertices)
+{
+  assert(0 <= band_id && band_id < BAND_COUNT);
+  assert(ctx->extraction_mode == ISOLINES_EXTRACT_BANDS);
+
+  *indices = ctx->isoband_indices[band_id];
+  *vertices = ctx->isoband_vertices;
+
+  return ctx->isoband_index_counts[band_id];
+}
+
+int
+get_isolines_dual_r(struct isolines_context_t *ctx, int threshold_id, 
+                    const unsigned int **indices, const float **vertices)
+{
+  assert(0 <= threshold_id && threshold_id < THRESHOLD_COUNT);
+  assert(ctx->extraction_mode == ISOLINES_EXTRACT_DUAL);
+
+  *indices = &ctx->dual_indices[ctx->dual_threshold_offsets[threshold_id]];
+  *vertices = ctx->dual_vertices;
+
+  return ctx->dual_threshold_offsets[threshold_id + 1] - 
+         ctx->dual_threshold_offsets[threshold_id];
+}
+
+void
+get_isolines_level_metrics_r(struct isolines_context_t *ctx, int threshold_id,
+                             struct isolines_level_metrics_t *metrics)
+{
+  struct level_metrics_sums_t *sums;
+
+  assert(0 <= threshold_id && threshold_id < THRESHOLD_COUNT);
+  assert(ctx->extraction_mode == ISOLINES_EXTRACT_SEGMENTS || 
+         ctx->extraction_mode == ISOLINES_EXTRACT_INCREMENTAL || 
+         ctx->extraction_mode == ISOLINES_EXTRACT_ADAPTIVE);
+
+  sums = &ctx->isolines_level_metrics[threshold_id];
+
+  metrics->length = sums->length;
+  metrics->area = sums->area2 * 0.5;
+  metrics->min = sums->min;
+  metrics->max = sums->max;
+
+  if(sums->area2 != 0.0)
+  {
+    metrics->centroid.x = sums->centroid6_x / (3.0 * sums->area2);
+    metrics->centroid.y = sums->centroid6_y / (3.0 * sums->area2);
+  }
+  else
+    metrics->centroid = (struct point2d_t){0.f, 0.f};
+}
+
+void
+extract_isolines_batch_r(struct isolines_context_t *ctx, const struct isolines_field_t *fields, 
+                         int field_count, struct isolines_batch_t *batch)
+{
+  int slot_count, component_count;
+
+  batch->field_count = field_count;
+  batch->field_levels = xreserve(batch->field_levels, &batch->field_level_capacity, 
+                                 field_count + 1, sizeof(int));
+  batch->field_levels[0] = 0;
+  for(int i = 0; i < field_count; i++)
+  {
+    assert(fields[i].threshold_count >= 0);
+    batch->field_levels[i + 1] = batch->field_levels[i] + fields[i].threshold_count;
+  }
+
+  batch->level_count = batch->field_levels[field_count];
+  batch->level_offsets = xreserve(batch->level_offsets, &batch->level_offset_capacity, 
+                                  batch->level_count + 1, sizeof(int));
+
+  ctx->batch_fields = fields;
+  ctx->batch = batch;
+
+  slot_count = plan_batch_jobs(ctx, field_count);
+  ctx->batch_state_masks = xreserve(ctx->batch_state_masks, &ctx->batch_state_mask_capacity,
+                                    place_batch_state_masks(ctx), sizeof(uint8_t));
+  ctx->batch_slot_counts = xreserve(ctx->batch_slot_counts, &ctx->batch_slot_count_capacity, 
+                                    slot_count, sizeof(int));
+  ctx->batch_slot_offsets = xreserve(ctx->batch_slot_offsets, &ctx->batch_slot_offset_capacity, 
+                                     slot_count, sizeof(int));
+
+  pool_run(&ctx->isolines_pool, run_batch_count_job, ctx, ctx->batch_job_count);
+
+  component_count = place_batch_slots(ctx);
+  batch->components = xreserve(batch->components, &batch->component_capacity, component_count, 
+                               sizeof(float));
+
+  pool_run(&ctx->isolines_pool, run_batch_fill_job, ctx, ctx->batch_job_count);
+
+  batch->component_count = component_count;
+
+  ctx->batch_fields = NULL;
+  ctx->batch = NULL;
+}
+
+int
+get_isolines_batch_field(const struct isolines_batch_t *batch, int field_id, 
+                         const float **components)
+{
+  int first = batch->level_offsets[batch->field_levels[field_id]];
+
+  assert(0 <= field_id && field_id < batch->field_count);
+
+  *components = &batch->components[first];
+  return batch->level_offsets[batch->field_levels[field_id + 1]] - first;
+}
+
+int
+get_isolines_batch_level(const struct isolines_batch_t *batch, int field_id, int threshold_id,
+                         const float **components)
+{
+  int level = batch->field_levels[field_id] + threshold_id;
+
+  assert(0 <= field_id && field_id < batch->field_count);
+  assert(level < batch->field_levels[field_id + 1]);
+
+  *components = &batch->components[batch->level_offsets[level]];
+  return batch->level_offsets[level + 1] - batch->level_offsets[level];
+}
+
+void
+free_isolines_batch(struct isolines_batch_t *batch)
+{
+  free(batch->components);
+  free(batch->field_levels);
+  free(batch->level_offsets);
+  memset((void *)batch, 0, sizeof(struct isolines_batch_t));
+}
+
+struct isolines_stream_t *
+create_isolines_stream(int line_length, float cell_size_m, const float *thresholds, 
+                       int threshold_count)
+{
+  struct isolines_stream_t *stream = xmalloc(sizeof(struct isolines_stream_t));
+  int edge_point_count = threshold_count * (line_length - 1);
+
+  assert(line_length >= 2 && threshold_count >= 0);
+
+  memset((void *)stream, 0, sizeof(struct isolines_stream_t));
+  stream->line_length = line_length;
+  stream->cell_size_m = cell_size_m;
+  stream->threshold_count = threshold_count;
+  stream->thresholds = xmalloc(sizeof(float) * (threshold_count + 1));
+  memcpy((void *)stream->thresholds, (void *)thresholds, sizeof(float) * threshold_count);
+  stream->weights = xmalloc(sizeof(float) * line_length);
+  stream->prev_weights = xmalloc(sizeof(float) * line_length);
+  stream->edge_points = xmalloc(sizeof(float) * (edge_point_count + 1));
+  stream->prev_edge_points = xmalloc(sizeof(float) * (edge_point_count + 1));
+  stream->level_offsets = xmalloc(sizeof(int) * (threshold_count + 1));
+  memset((void *)stream->level_offsets, 0, sizeof(int) * (threshold_count + 1));
+
+  return stream;
+}
+
+void
+destroy_isolines_stream(struct isolines_stream_t *stream)
+{
+  free(stream->thresholds);
+  free(stream->weights);
+  free(stream->prev_weights);
+  free(stream->edge_points);
+  free(stream->prev_edge_points);
+  free(stream->components);
+  free(stream->level_offsets);
+  free(stream);
+}
+
+int
+push_isolines_stream_line(struct isolines_stream_t *stream, const float *weights, 
+                          const float **components)
+{
+  float *swap;
+
+  /* the last line becomes the previous line; its samples and points are kept, not copied */
+  swap = stream->prev_weights;
+  stream->prev_weights = stream->weights;
+  stream->weights = swap;
+  swap = stream->prev_edge_points;
+  stream->prev_edge_points = stream->edge_points;
+  stream->edge_points = swap;
+
+  memcpy((void *)stream->weights, (void *)weights, sizeof(float) * stream->line_length);
+  ++stream->line_count;
+
+  lerp_stream_edges(stream);
+
+  if(stream->line_count >= 2)
+    generate_stream_column(stream);
+
+  *components = stream->components;
+  return stream->component_count;
+}
+
+int
+get_isolines_stream_level(const struct isolines_stream_t *stream, int threshold_id, 
+                          const float **components)
+{
+  assert(0 <= threshold_id && threshold_id < stream->threshold_count);
+
+  *components = &stream->components[stream->level_offsets[threshold_id]];
+  return stream->level_offsets[threshold_id + 1] - stream->level_offsets[threshold_id];
+}
+
+bool
+extract_isolines_raster_r(struct isolines_context_t *ctx, const struct isolines_raster_t *raster)
+{
+  int tile_count;
+
+  assert(raster->col_count >= 2 && raster->row_count >= 2);
+
+  ctx->raster = raster;
+  ctx->raster_tile_col_count = ((raster->col_count - 1) + ISOLINES_RASTER_TILE_SIZE - 1) / 
+                               ISOLINES_RASTER_TILE_SIZE;
+  ctx->raster_tile_row_count = ((raster->row_count - 1) + ISOLINES_RASTER_TILE_SIZE - 1) / 
+                               ISOLINES_RASTER_TILE_SIZE;
+  ctx->is_raster_read_failed = false;
+
+  tile_count = ctx->raster_tile_col_count * ctx->raster_tile_row_count;
+  if(tile_count > ctx->raster_tile_capacity)
+  {
+    ctx->raster_tiles = xrealloc(ctx->raster_tiles, sizeof(struct raster_tile_t) * tile_count);
+    memset((void *)&ctx->raster_tiles[ctx->raster_tile_capacity], 0, 
+           sizeof(struct raster_tile_t) * (tile_count - ctx->raster_tile_capacity));
+    ctx->raster_tile_capacity = tile_count;
+  }
+
+  pool_run(&ctx->isolines_pool, run_raster_tile_job, ctx, tile_count);
+
+  /* the polylines replace those of the last tick */
+  reset_isolines_polylines(ctx);
+  ctx->raster_threshold_count = raster->threshold_count;
+  ctx->raster_threshold_offsets = xreserve(ctx->raster_threshold_offsets, 
+                                           &ctx->raster_threshold_offset_capacity, 
+                                           raster->threshold_count + 1, sizeof(int));
+
+  for(int i = 0; i < raster->threshold_count; i++)
+  {
+    ctx->raster_threshold_offsets[i] = ctx->isolines_polyline_count;
+    stitch_raster_threshold(ctx, i);
+  }
+  ctx->raster_threshold_offsets[raster->threshold_count] = ctx->isolines_polyline_count;
+
+  release_raster_tiles(ctx);
+  ctx->raster = NULL;
+
+  return !ctx->is_raster_read_failed;
+}
+
+int
+get_isolines_raster_polylines_r(struct isolines_context_t *ctx, int threshold_id, 
+                                const struct isoline_polyline_t **polylines, 
+                                const float **vertices)
+{
+  assert(0 <= threshold_id && threshold_id < ctx->raster_threshold_count);
+
+  *polylines = &ctx->isolines_polylines[ctx->raster_threshold_offsets[threshold_id]];
+  *vertices = ctx->isolines_polyline_mesh;
+
+  return ctx->raster_threshold_offsets[threshold_id + 1] - 
+         ctx->raster_threshold_offsets[threshold_id];
+}
+
+void
+label_isolines_components_r(struct isolines_context_t *ctx)
+{
+  struct isolines_component_t *component;
+  const struct component_sums_t *sums;
+  int component_count = 0, threshold_id;
+  double area;
+
+  pool_run(&ctx->isolines_pool, run_component_label_job, ctx, ISOLINES_JOB_COUNT);
+
+  for(int i = 0; i < THRESHOLD_COUNT; i++)
+    join_component_seams(ctx, i);
+
+  pool_run(&ctx->isolines_pool, run_component_count_job, ctx, ISOLINES_JOB_COUNT);
+
+  /* the jobs are ordered by threshold then strip, so numbering the roots in job order numbers the
+   * regions of each threshold in order of their roots */
+  for(int i = 0; i < ISOLINES_JOB_COUNT; i++)
+  {
+    threshold_id = i / ISOLINES_STRIP_COUNT;
+    if(i % ISOLINES_STRIP_COUNT == 0)
+      ctx->component_threshold_offsets[threshold_id] = component_count;
+
+    ctx->job_component_offsets[i] = component_count - 
+                                    ctx->component_threshold_offsets[threshold_id];
+    component_count += ctx->job_component_counts[i];
+  }
+  ctx->component_threshold_offsets[THRESHOLD_COUNT] = component_count;
+
+  ctx->components = xreserve(ctx->components, &ctx->component_capacity, component_count, 
+                             sizeof(struct isolines_component_t));
+
+  pool_run(&ctx->isolines_pool, run_component_id_job, ctx, ISOLINES_JOB_COUNT);
+  pool_run(&ctx->isolines_pool, run_component_cell_job, ctx, ISOLINES_JOB_COUNT);
+
+  /* summed in job order, so the areas are the same every run */
+  for(int i = 0; i < THRESHOLD_COUNT; i++)
+  {
+    for(int j = ctx->component_threshold_offsets[i]; j < ctx->component_threshold_offsets[i + 1]; 
+        j++)
+    {
+      component = &ctx->components[j];
+      component->cell_count = 0;
+      area = 0.0;
+      for(int strip = 0; strip < ISOLINES_STRIP_COUNT; strip++)
+      {
+        sums = &ctx->job_component_sums[(i * ISOLINES_STRIP_COUNT) + strip]
+                                       [j - ctx->component_threshold_offsets[i]];
+        area += sums->area;
+        component->cell_count += sums->cell_count;
+      }
+      component->area = area * CELL_SIZE_M * CELL_SIZE_M;
+    }
+  }
+}
+
+int
+get_isolines_components_r(struct isolines_context_t *ctx, int threshold_id, 
+                          const struct isolines_component_t **components)
+{
+  assert(0 <= threshold_id && threshold_id < THRESHOLD_COUNT);
+
+  *components = &ctx->components[ctx->component_threshold_offsets[threshold_id]];
+
+  return ctx->component_threshold_offsets[threshold_id + 1] - 
+         ctx->component_threshold_offsets[threshold_id];
+}
+
+const int *
+get_isolines_component_labels_r(struct isolines_context_t *ctx, int threshold_id, 
+                                int *col_count, int *row_count)
+{
+  assert(0 <= threshold_id && threshold_id < THRESHOLD_COUNT);
+
+  *col_count = SAMPLE_GRID_COL_COUNT - 1;
+  *row_count = SAMPLE_GRID_ROW_COUNT - 1;
+
+  return ctx->component_labels[threshold_id];
+}
+
+void
+find_isolines_nearest_segments_r(struct isolines_context_t *ctx, 
+                                 const struct point2d_t *points_w_m, int point_count,
+                                 struct isolines_segment_hit_t *hits)
+{
+  int job_count = begin_segment_queries(ctx, points_w_m, point_count);
+
+  ctx->segment_hits = hits;
+  if(job_count > 0)
+    pool_run(&ctx->isolines_pool, run_segment_nearest_job, ctx, job_count);
+  ctx->segment_hits = NULL;
+}
+
+int
+find_isolines_segments_in_radius_r(struct isolines_context_t *ctx, 
+                                   const struct point2d_t *points_w_m, int point_count, 
+                                   float radius_m, const int **offsets, const int **segments)
+{
+  int job_count = begin_segment_queries(ctx, points_w_m, point_count);
+
+  ctx->segment_query_radius_m = radius_m;
+  ctx->segment_query_offsets = xreserve(ctx->segment_query_offsets, 
+                                        &ctx->segment_query_offset_capacity, point_count + 1, 
+                                        sizeof(int));
+  ctx->segment_query_offsets[0] = 0;
+  if(job_count > 0)
+    pool_run(&ctx->isolines_pool, run_segment_radius_count_job, ctx, job_count);
+
+  for(int i = 1; i <= point_count; i++)
+    ctx->segment_query_offsets[i] += ctx->segment_query_offsets[i - 1];
+
+  ctx->found_segments = xreserve(ctx->found_segments, &ctx->found_segment_capacity, 
+                                 ctx->segment_query_offsets[point_count], sizeof(int));
+  if(job_count > 0)
+    pool_run(&ctx->isolines_pool, run_segment_radius_fill_job, ctx, job_count);
+
+  *offsets = ctx->segment_query_offsets;
+  *segments = ctx->found_segments;
+
+  return ctx->segment_query_offsets[point_count];
+}
+
+/*** DEFAULT CONTEXT *****************************************************************************/
+
+/* the context operated on by the functions without the '_r' suffix; created by 'init_isolines' */
+static struct isolines_context_t *default_isolines;
+
+void
+init_isolines(struct point2d_t grid_pos_w_m)
+{
+  assert(default_isolines == NULL);
+  default_isolines = create_isolines_context(grid_pos_w_m);
+}
+
+void
+tick_isolines(void)
+{
+  tick_isolines_r(default_isolines);
+}
+
+void
+draw_isolines(void)
+{
+  draw_isolines_r(default_isolines);
+}
+
+void
+set_isolines_extraction_mode(enum isolines_extraction_mode_t mode)
+{
+  set_isolines_extraction_mode_r(default_isolines, mode);
+}
+
+enum isolines_extraction_mode_t
+get_isolines_extraction_mode(void)
+{
+  return get_isolines_extraction_mode_r(default_isolines);
+}
+
+int
+get_isolines_polylines(int threshold_id, 
+                       const struct isoline_polyline_t **polylines, 
+                       const float **vertices)
+{
+  return get_isolines_polylines_r(default_isolines, threshold_id, polylines, vertices);
+}
+
+void
+set_isolines_field_frozen(bool is_frozen)
+{
+  set_isolines_field_frozen_r(default_isolines, is_frozen);
+}
+
+bool
+is_isolines_field_frozen(void)
+{
+  return is_isolines_field_frozen_r(default_isolines);
+}
+
+void
+shift_isolines_thresholds(float delta)
+{
+  shift_isolines_thresholds_r(default_isolines, delta);
+}
+
+void
+set_isolines_pixel_size(float pixel_size_m)
+{
+  set_isolines_pixel_size_r(default_isolines, pixel_size_m);
+}
+
+void
+set_isolines_view_rect(struct point2d_t min_w_m, struct point2d_t max_w_m)
+{
+  set_isolines_view_rect_r(default_isolines, min_w_m, max_w_m);
+}
+
+void
+clear_isolines_view_rect(void)
+{
+  clear_isolines_view_rect_r(default_isolines);
+}
+
+void
+set_isolines_focus(struct point2d_t focus_w_m)
+{
+  set_isolines_focus_r(default_isolines, focus_w_m);
+}
+
+int
+get_isolines_mesh(const float **components)
+{
+  return get_isolines_mesh_r(default_isolines, components);
+}
+
+int
+get_isolines_mesh_level(int threshold_id, const float **components)
+{
+  return get_isolines_mesh_level_r(default_isolines, threshold_id, components);
+}
+
+const struct isolines_mesh_slab_t *
+get_isolines_mesh_slabs(void)
+{
+  return get_isolines_mesh_slabs_r(default_isolines);
+}
+
+int
+get_isolines_bands(int band_id, const unsigned int **indices, const float **vertices)
+{
+  return get_isolines_bands_r(default_isolines, band_id, indices, vertices);
+}
+
+void
+get_isolines_level_metrics(int threshold_id, struct isolines_level_metrics_t *metrics)
+{
+  get_isolines_level_metrics_r(default_isolines, threshold_id, metrics);
+}
+
+int
+get_isolines_dual(int threshold_id, const unsigned int **indices, const float **vertices)
+{
+  return get_isolines_dual_r(default_isolines, threshold_id, indices, vertices);
+}
+
+void
+extract_isolines_batch(const struct isolines_field_t *fields, int field_count, 
+                       struct isolines_batch_t *batch)
+{
+  extract_isolines_batch_r(default_isolines, fields, field_count, batch);
+}
+
+bool
+extract_isolines_raster(const struct isolines_raster_t *raster)
+{
+  return extract_isolines_raster_r(default_isolines, raster);
+}
+
+int
+get_isolines_raster_polylines(int threshold_id, const struct isoline_polyline_t **polylines, 
+                              const float **vertices)
+{
+  return get_isolines_raster_polylines_r(default_isolines, threshold_id, polylines, vertices);
+}
+
+void
+label_isolines_components(void)
+{
+  label_isolines_components_r(default_isolines);
+}
+
+int
+get_isolines_components(int threshold_id, const struct isolines_component_t **components)
+{
+  return get_isolines_components_r(default_isolines, threshold_id, components);
+}
+
+const int *
+get_isolines_component_labels(int threshold_id, int *col_count, int *row_count)
+{
+  return get_isolines_component_labels_r(default_isolines, threshold_id, col_count, row_count);
+}
+
+void
+find_isolines_nearest_segments(const struct point2d_t *points_w_m, int point_count,
+                               struct isolines_segment_hit_t *hits)
+{
+  find_isolines_nearest_segments_r(default_isolines, points_w_m, point_count, hits);
+}
+
+int
+find_isolines_segments_in_radius(const struct point2d_t *points_w_m, int point_count, 
+                                 float radius_m, const int **offsets, const int **segments)
+{
+  return find_isolines_segments_in_radius_r(default_isolines, points_w_m, point_count, radius_m,
+                                            offsets, segments);
+}
@@ -1,6 +1,8 @@
 #ifndef _ISOLINES_H_
 #define _ISOLINES_H_
 
+#include <stdbool.h>
+
 /* a point (position vector) in a 2d plane */
 struct point2d_t
 {
@@ -15,6 +17,92 @@ struct vector2d_t
   float y;
 };
 
+/* the form in which the isolines are extracted (and drawn) */
+enum isolines_extraction_mode_t
+{
+  ISOLINES_EXTRACT_SEGMENTS,  /* disconnected line segments in cell order; drawn as GL_LINES */
+  ISOLINES_EXTRACT_POLYLINES, /* segments stitched into ordered open strips and closed loops */
+  ISOLINES_EXTRACT_TRACE,     /* polylines traced cell to cell from seeds; only the cells the 
+                               * contours pass through are evaluated */
+  ISOLINES_EXTRACT_INCREMENTAL, /* disconnected line segments kept per tile of cells between ticks;
+                                 * only tiles whose samples changed are re-extracted */
+  ISOLINES_EXTRACT_BANDS,       /* filled bands between successive thresholds as indexed 
+                                 * triangles; drawn as GL_TRIANGLES */
+  ISOLINES_EXTRACT_ADAPTIVE,    /* disconnected line segments, as ISOLINES_EXTRACT_SEGMENTS, but
+                                 * only from the cells a quadtree over the grid refines down to;
+                                 * only the samples of those cells are evaluated */
+  ISOLINES_EXTRACT_DUAL,        /* one vertex per cell the isolines cross, joined across the 
+                                 * crossed edges (2d surface nets) as indexed lines; drawn as 
+                                 * GL_LINES elements */
+  ISOLINES_EXTRACTION_MODE_COUNT
+};
+
+/* an ordered, connected run of isoline vertices. Open polylines begin and end on the boundary of
+ * the grid; closed polylines loop back to their first vertex (which is not repeated). */
+struct isoline_polyline_t
+{
+  int first_vertex;  /* offset of the first vertex in the polyline vertex array (unit: vertices) */
+  int vertex_count;
+  bool is_closed;
+
+  /* metrics of the polyline as extracted (before any simplification), in grid space; the area 
+   * enclosed by a closed polyline and the centroid of that area, or for an open polyline zero 
+   * area and the centroid of the line itself (unit: meters) */
+  float length;
+  float area;
+  struct point2d_t centroid;
+  struct point2d_t min, max; /* bounding box */
+
+  /* the nesting of a closed polyline among the closed polylines of all thresholds, which form a 
+   * tree since isolines never cross (e.g. a peak within a region within a hole). The parent is the
+   * innermost closed polyline enclosing this one, as the index of its threshold and its index 
+   * among the polylines of that threshold, or -1 for both if none does; the depth is the number 
+   * of closed polylines enclosing it. Open polylines are not nested (-1, -1 and 0). Only set in 
+   * modes ISOLINES_EXTRACT_POLYLINES and ISOLINES_EXTRACT_TRACE, from the contours as extracted 
+   * (before any simplification). */
+  int parent_threshold_id;
+  int parent_id;
+  int depth;
+};
+
+/* metrics of the isolines of a threshold (level), in grid space (unit: meters) */
+struct isolines_level_metrics_t
+{
+  float length;              /* the total length of the isolines */
+  float area;                /* the area of the grid at or above the threshold */
+  struct point2d_t centroid; /* the centroid of that area; the origin if the area is zero */
+  struct point2d_t min, max; /* bounding box of the isolines; inverted (min > max) if empty */
+};
+
+/* the size of a slab of the isolines mesh (unit: vertex components); a multiple of 4 so segments
+ * are never split between slabs */
+#define ISOLINES_MESH_SLAB_SIZE 4096
+
+/* a fixed size slab of the isolines mesh; when the mesh is built in slabs it is a linked list of
+ * slabs, each holding a run of whole segments packed as grid space {x0, y0, x1, y1} */
+struct isolines_mesh_slab_t
+{
+  struct isolines_mesh_slab_t *next;
+  int component_count;
+  float components[ISOLINES_MESH_SLAB_SIZE];
+};
+
+/* the state of a simulated weight field and its isolines. Each function of this module has a
+ * reentrant form, suffixed '_r', that operates on the context given as its first argument; the
+ * unsuffixed form operates on a default context created by 'init_isolines'. Contexts share no
+ * state (each has its own thread pool), so separate contexts may be ticked concurrently from 
+ * separate threads, but a single context must only be used by one thread at a time. Drawing 
+ * requires the thread to hold the opengl context. */
+struct isolines_context_t;
+
+/* creates a context whose grid is positioned at 'grid_pos_w_m' (world space) */
+struct isolines_context_t *
+create_isolines_context(struct point2d_t grid_pos_w_m);
+
+void
+destroy_isolines_context(struct isolines_context_t *ctx);
+
+/* creates the default context */
 void
 init_isolines(struct point2d_t grid_pos_w_m);
 
@@ -24,5 +112,393 @@ tick_isolines(void);
 void
 draw_isolines(void);
 
+/* select the extraction mode used by future ticks; defaults to ISOLINES_EXTRACT_SEGMENTS */
+void
+set_isolines_extraction_mode(enum isolines_extraction_mode_t mode);
+
+enum isolines_extraction_mode_t
+get_isolines_extraction_mode(void);
+
+/* freeze (or unfreeze) the weight field. While frozen the globs stop moving and the field is 
+ * indexed by the range of weights in each tile of cells, so the isolines of a threshold are 
+ * extracted only from the tiles they pass through; this makes changing the thresholds of a static
+ * field cheap. */
+void
+set_isolines_field_frozen(bool is_frozen);
+
+bool
+is_isolines_field_frozen(void);
+
+/* add 'delta' to every threshold (isovalue) */
+void
+shift_isolines_thresholds(float delta);
+
+/* set the size of a pixel of the view projected onto the grid (unit: meters); chooses the level 
+ * of detail of the extraction. When the cells of the grid are projected too small to be seen 
+ * apart, the mode ISOLINES_EXTRACT_SEGMENTS samples and extracts a coarser lattice of every 2^k 
+ * samples instead (while the field is not frozen). Defaults to full detail. */
+void
+set_isolines_pixel_size(float pixel_size_m);
+
+/* set the rectangle (world space) of the grid in view; the mode ISOLINES_EXTRACT_SEGMENTS then 
+ * evaluates and extracts only the cells in view and a guard band around them (while the field is
+ * not frozen), so the isolines mesh and its metrics cover only that part of the grid. Defaults to
+ * no culling. */
+void
+set_isolines_view_rect(struct point2d_t min_w_m, struct point2d_t max_w_m);
+
+/* stop culling the extraction to the view */
+void
+clear_isolines_view_rect(void);
+
+/* set the point (world space) the incremental remeshing (ISOLINES_EXTRACT_INCREMENTAL) works 
+ * outwards from when it cannot re-extract every dirty tile within the budget of a tick; usually
+ * the centre of the view */
+void
+set_isolines_focus(struct point2d_t focus_w_m);
+
+/* access the isolines mesh generated by the last tick as one contiguous array of segments packed
+ * as grid space {x0, y0, x1, y1}; only valid in modes ISOLINES_EXTRACT_SEGMENTS, 
+ * ISOLINES_EXTRACT_INCREMENTAL and ISOLINES_EXTRACT_ADAPTIVE. When the mesh is built in slabs (or
+ * tiles) this compacts them (at most once per tick). Returns the component count. */
+int
+get_isolines_mesh(const float **components);
+
+/* access the segments of a single threshold (level, by its index into the thresholds) of the 
+ * isolines mesh generated by the last tick, as a contiguous run of {x0, y0, x1, y1} within the 
+ * array given by 'get_isolines_mesh'; only valid in the modes 'get_isolines_mesh' is. Returns the
+ * component count of the level. */
+int
+get_isolines_mesh_level(int threshold_id, const float **components);
+
+/* access the metrics of a threshold (level) of the isolines mesh generated by the last tick; only
+ * valid in the modes 'get_isolines_mesh' is. The metrics are accumulated during extraction so cost
+ * no pass over the mesh. (The metrics of each contour are part of the polylines, in the polyline 
+ * modes.) */
+void
+get_isolines_level_metrics(int threshold_id, struct isolines_level_metrics_t *metrics);
+
+/* access the slabs of the isolines mesh generated by the last tick in place (zero-copy); only 
+ * valid in modes ISOLINES_EXTRACT_SEGMENTS and ISOLINES_EXTRACT_ADAPTIVE. Returns NULL if the mesh
+ * is empty or is not built in slabs. */
+const struct isolines_mesh_slab_t *
+get_isolines_mesh_slabs(void);
+
+/* access the polylines of a threshold (by its index into the thresholds) generated by the last 
+ * tick; only valid in modes ISOLINES_EXTRACT_POLYLINES and ISOLINES_EXTRACT_TRACE. The vertex 
+ * array is shared by all polylines and stores grid space vertices as packed {x, y} pairs. Returns
+ * the polyline count. */
+int
+get_isolines_polylines(int threshold_id, 
+                       const struct isoline_polyline_t **polylines, 
+                       const float **vertices);
+
+/* access the triangles of a band generated by the last tick; only valid in mode 
+ * ISOLINES_EXTRACT_BANDS. Band i holds the weights in [threshold i, threshold i+1), and the last
+ * band all weights at or above the last threshold. The vertex array is shared by all bands (as 
+ * are the vertices on the borders between bands) and stores grid space vertices as packed {x, y}
+ * pairs. Returns the index count (3 per triangle). */
+int
+get_isolines_bands(int band_id, const unsigned int **indices, const float **vertices);
+
+/* access the segments of a threshold generated by the last tick; only valid in mode 
+ * ISOLINES_EXTRACT_DUAL. Each segment is a pair of indices into the vertex array, which is shared 
+ * by all thresholds and stores grid space vertices as packed {x, y} pairs; a vertex is shared by 
+ * all the segments which meet at it. Returns the index count (2 per segment). */
+int
+get_isolines_dual(int threshold_id, const unsigned int **indices, const float **vertices);
+
+/* the reentrant forms of the functions above (see 'struct isolines_context_t') */
+
+void
+tick_isolines_r(struct isolines_context_t *ctx);
+
+void
+draw_isolines_r(struct isolines_context_t *ctx);
+
+void
+set_isolines_extraction_mode_r(struct isolines_context_t *ctx, 
+                               enum isolines_extraction_mode_t mode);
+
+enum isolines_extraction_mode_t
+get_isolines_extraction_mode_r(struct isolines_context_t *ctx);
+
+void
+set_isolines_field_frozen_r(struct isolines_context_t *ctx, bool is_frozen);
+
+bool
+is_isolines_field_frozen_r(struct isolines_context_t *ctx);
+
+void
+shift_isolines_thresholds_r(struct isolines_context_t *ctx, float delta);
+
+void
+set_isolines_pixel_size_r(struct isolines_context_t *ctx, float pixel_size_m);
+
+void
+set_isolines_view_rect_r(struct isolines_context_t *ctx, struct point2d_t min_w_m, 
+                         struct point2d_t max_w_m);
+
+void
+clear_isolines_view_rect_r(struct isolines_context_t *ctx);
+
+void
+set_isolines_focus_r(struct isolines_context_t *ctx, struct point2d_t focus_w_m);
+
+int
+get_isolines_mesh_r(struct isolines_context_t *ctx, const float **components);
+
+int
+get_isolines_mesh_level_r(struct isolines_context_t *ctx, int threshold_id, 
+                          const float **components);
+
+void
+get_isolines_level_metrics_r(struct isolines_context_t *ctx, int threshold_id, 
+                             struct isolines_level_metrics_t *metrics);
+
+const struct isolines_mesh_slab_t *
+get_isolines_mesh_slabs_r(struct isolines_context_t *ctx);
+
+int
+get_isolines_polylines_r(struct isolines_context_t *ctx, int threshold_id, 
+                         const struct isoline_polyline_t **polylines, 
+                         const float **vertices);
+
+int
+get_isolines_bands_r(struct isolines_context_t *ctx, int band_id, const unsigned int **indices, 
+                     const float **vertices);
+
+int
+get_isolines_dual_r(struct isolines_context_t *ctx, int threshold_id, 
+                    const unsigned int **indices, const float **vertices);
+
+/*** BATCH ***************************************************************************************/
+
+/* an independent weight field to be contoured by a batch extraction (see 
+ * 'extract_isolines_batch'). The samples lie on a regular grid, stored column by column as the 
+ * grid of the simulation is, i.e. the weight of the sample at (col, row) is:
+ *    weights[(col * row_count) + row] */
+struct isolines_field_t
+{
+  const float *weights;
+  int col_count;            /* unit: samples */
+  int row_count;
+  float cell_size_m;        /* the separation of the samples (unit: meters) */
+  const float *thresholds;
+  int threshold_count;
+};
+
+/* the isolines of a batch of fields, packed into one array of segments, each as {x0, y0, x1, y1}
+ * in the grid space of its field. The levels (thresholds) of all fields are numbered in order, 
+ * field by field: the levels of field i are [field_levels[i], field_levels[i + 1]) and the 
+ * segments of level k are the components [level_offsets[k], level_offsets[k + 1]). Zero a batch 
+ * before its first use; its arrays are kept (and grown as needed) by each extraction into it, 
+ * until 'free_isolines_batch'. */
+struct isolines_batch_t
+{
+  float *components;
+  int component_count;
+  int component_capacity;
+
+  int *field_levels;        /* field_count + 1 elements */
+  int field_count;
+  int field_level_capacity;
+
+  int *level_offsets;       /* level_count + 1 elements (unit: vertex components) */
+  int level_count;
+  int level_offset_capacity;
+};
+
+/* extracts the isolines of every threshold of every field into the batch, replacing its contents.
+ * The fields are packed together (or, if large, split into strips of columns) into jobs of 
+ * similar cost run on the thread pool, so many small fields are extracted about as fast as one 
+ * field of the same total size. The output does not depend on the thread count. */
+void
+extract_isolines_batch(const struct isolines_field_t *fields, int field_count, 
+                       struct isolines_batch_t *batch);
+
+/* access the segments of a field of the batch, or of a single threshold of the field; returns the
+ * component count */
+int
+get_isolines_batch_field(const struct isolines_batch_t *batch, int field_id, 
+                         const float **components);
+
+int
+get_isolines_batch_level(const struct isolines_batch_t *batch, int field_id, int threshold_id,
+                         const float **components);
+
+void
+free_isolines_batch(struct isolines_batch_t *batch);
+
+/* the reentrant form of 'extract_isolines_batch' (see 'struct isolines_context_t') */
+void
+extract_isolines_batch_r(struct isolines_context_t *ctx, const struct isolines_field_t *fields, 
+                         int field_count, struct isolines_batch_t *batch);
+
+/*** STREAMING ***********************************************************************************/
+
+/* a streaming extraction of the isolines of an unbounded field, whose samples are pushed one line
+ * at a time (e.g. as they are read from a sensor or a file); each push extracts the column of 
+ * cells between the line and the one before it, and only those two lines are kept, so the memory
+ * used depends only on the length of the lines. Line i lies at x = i * cell_size_m, and sample j 
+ * of each line at y = j * cell_size_m. A stream is not tied to any context. */
+struct isolines_stream_t;
+
+/* creates a stream of lines of 'line_length' (at least 2) samples; the thresholds are copied */
+struct isolines_stream_t *
+create_isolines_stream(int line_length, float cell_size_m, const float *thresholds, 
+                       int threshold_count);
+
+void
+destroy_isolines_stream(struct isolines_stream_t *stream);
+
+/* pushes the next line of samples (copied) and extracts the column of cells it completes, as 
+ * segments packed {x0, y0, x1, y1} threshold by threshold; the segments are valid until the next
+ * push. Returns the component count, which is zero for the first line. */
+int
+push_isolines_stream_line(struct isolines_stream_t *stream, const float *weights, 
+                          const float **components);
+
+/* access the segments of a single threshold of the column of cells completed by the last push; 
+ * returns the component count */
+int
+get_isolines_stream_level(const struct isolines_stream_t *stream, int threshold_id, 
+                          const float **components);
+
+/*** RASTERS *************************************************************************************/
+
+/* reads the samples [col0, col0 + col_count) x [row0, row0 + row_count) of a raster into 
+ * 'weights', column by column (i.e. the sample (col0 + i, row0 + j) into the element 
+ * (i * row_count) + j); returns false if the read failed. Called concurrently from the threads of
+ * the pool, so must be thread-safe. */
+typedef bool (*isolines_raster_read_fn)(void *user, int col0, int row0, int col_count, 
+                                        int row_count, float *weights);
+
+/* a raster of samples too large to be held in memory, read a tile at a time (see 
+ * 'extract_isolines_raster') */
+struct isolines_raster_t
+{
+  int col_count;            /* unit: samples */
+  int row_count;
+  float cell_size_m;        /* the separation of the samples (unit: meters) */
+  const float *thresholds;
+  int threshold_count;
+
+  isolines_raster_read_fn read;
+  void *user;               /* passed to 'read' */
+};
+
+/* extracts the isolines of every threshold of the raster as polylines, one tile at a time. Each 
+ * tile is read (and extracted) by a job of the thread pool, so the reads of some tiles overlap 
+ * the extraction of others and only one tile of samples per thread is held in memory; the pieces
+ * of the isolines in each tile are stitched across the seams between tiles into continuous 
+ * polylines. Only the samples are bounded by the tiles in flight: the pieces of all tiles are 
+ * held until they are stitched, so the peak memory is proportional to the output (about twice 
+ * its vertices, as pieces and as polylines), and the pieces are freed once stitched. The 
+ * polylines replace those of the last tick (as a tick in a polyline mode would) and are accessed
+ * with 'get_isolines_raster_polylines'. Returns false if the read of any tile failed, in which 
+ * case the polylines are broken at the tiles not read. */
+bool
+extract_isolines_raster(const struct isolines_raster_t *raster);
+
+/* access the polylines of a threshold (by its index into the thresholds of the raster) extracted 
+ * by the last 'extract_isolines_raster'; as 'get_isolines_polylines'. The polylines are not 
+ * oriented. Returns the polyline count. */
+int
+get_isolines_raster_polylines(int threshold_id, const struct isoline_polyline_t **polylines, 
+                              const float **vertices);
+
+/* the reentrant forms of the functions above (see 'struct isolines_context_t') */
+bool
+extract_isolines_raster_r(struct isolines_context_t *ctx, const struct isolines_raster_t *raster);
+
+int
+get_isolines_raster_polylines_r(struct isolines_context_t *ctx, int threshold_id, 
+                                const struct isoline_polyline_t **polylines, 
+                                const float **vertices);
+
+/*** COMPONENTS **********************************************************************************/
+
+/* a connected region of the grid at or above a threshold (see 'label_isolines_components') */
+struct isolines_component_t
+{
+  float area;               /* unit: square meters */
+  int cell_count;           /* the number of cells the region covers, in whole or in part */
+};
+
+/* labels the connected regions of the grid at or above each threshold, from the samples as they
+ * were evaluated by the last tick; so only valid after a tick which evaluates the whole grid, 
+ * i.e. in any mode but ISOLINES_EXTRACT_TRACE and ISOLINES_EXTRACT_ADAPTIVE, and not culled to 
+ * the view or coarsened by the level of detail. The isolines of a saddle cell join its corners at
+ * or above the threshold, so samples touching only diagonally are in the same region. The 
+ * labelling runs on the thread pool and does not depend on the thread count. */
+void
+label_isolines_components(void);
+
+/* access the regions of a threshold labelled by the last 'label_isolines_components', in order of
+ * their first sample (column by column); returns the region count */
+int
+get_isolines_components(int threshold_id, const struct isolines_component_t **components);
+
+/* access the label of each cell of the grid for a threshold, by the last 
+ * 'label_isolines_components': the index of the region the cell is part of, or -1 if the cell is 
+ * entirely below the threshold. The grid has 'col_count' x 'row_count' cells and the label of the
+ * cell (col, row) is the element (col * row_count) + row. */
+const int *
+get_isolines_component_labels(int threshold_id, int *col_count, int *row_count);
+
+/* the reentrant forms of the functions above (see 'struct isolines_context_t') */
+void
+label_isolines_components_r(struct isolines_context_t *ctx);
+
+int
+get_isolines_components_r(struct isolines_context_t *ctx, int threshold_id, 
+                          const struct isolines_component_t **components);
+
+const int *
+get_isolines_component_labels_r(struct isolines_context_t *ctx, int threshold_id, 
+                                int *col_count, int *row_count);
+
+/*** SEGMENT INDEX *******************************************************************************/
+
+/* the nearest segment of the isolines mesh to a query point (see 
+ * 'find_isolines_nearest_segments') */
+struct isolines_segment_hit_t
+{
+  int segment;              /* the index of the segment in the array given by 'get_isolines_mesh'
+                             * (unit: segments, of 4 components); -1 if the mesh is empty */
+  int threshold_id;         /* the threshold (level) of the segment */
+  float distance_m;         /* the distance from the query point to the segment */
+  struct point2d_t point;   /* the point of the segment nearest the query point (world space) */
+};
+
+/* finds the nearest segment of the isolines mesh generated by the last tick to each of a batch of
+ * points (world space), into 'hits' (one per point); only valid in the modes 'get_isolines_mesh'
+ * is. The first query after a tick bins the segments on the cells of the grid, so each query 
+ * only searches the bins around its point rather than the whole mesh. The queries of a batch run 
+ * on the thread pool. */
+void
+find_isolines_nearest_segments(const struct point2d_t *points_w_m, int point_count,
+                               struct isolines_segment_hit_t *hits);
+
+/* finds the segments of the isolines mesh generated by the last tick within 'radius_m' of each of
+ * a batch of points (world space); as 'find_isolines_nearest_segments'. The segments (by index 
+ * into the array given by 'get_isolines_mesh', unit: segments) found for a point i are 
+ * [offsets[i], offsets[i + 1]) of 'segments'; both arrays are owned by the context and valid 
+ * until the next query. Returns the total count of segments found. */
+int
+find_isolines_segments_in_radius(const struct point2d_t *points_w_m, int point_count, 
+                                 float radius_m, const int **offsets, const int **segments);
+
+/* the reentrant forms of the functions above (see 'struct isolines_context_t') */
+void
+find_isolines_nearest_segments_r(struct isolines_context_t *ctx, 
+                                 const struct point2d_t *points_w_m, int point_count,
+                                 struct isolines_segment_hit_t *hits);
+
+int
+find_isolines_segments_in_radius_r(struct isolines_context_t *ctx, 
+                                   const struct point2d_t *points_w_m, int point_count, 
+                                   float radius_m, const int **offsets, const int **segments);
 
 #endif
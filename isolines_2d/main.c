@@ -4,15 +4,26 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <assert.h>
+#include <math.h>
 #include "clock.h"
 #include "isolines.h"
 
 #define TICK_DELTA_S 0.0166666
 #define MAX_TICKS_PER_FRAME 5
 
+/* change in the isolines thresholds per key press */
+#define THRESHOLD_SHIFT_DELTA 0.05f
+
 #define SCREEN_WIDTH_PX 1280
 #define SCREEN_HEIGHT_PX 720
 
+/* vertical field of view of the perspective projection */
+#define CAMERA_FOV_Y_DEG 60.0
+
+/* range of the distance of the camera from the grid */
+#define CAMERA_MIN_Z_M 2.f
+#define CAMERA_MAX_Z_M 500.f
+
 static GLfloat axis_vertices[] = {
    0.f  , 0.f  , 0.f  ,
    200.f, 0.f  , 0.f  ,   /* (+)x-axis */
@@ -81,7 +92,7 @@ init()
     exit(EXIT_SUCCESS);
   }
 
-  gluPerspective(60.0f, 
+  gluPerspective(CAMERA_FOV_Y_DEG, 
                  (double)SCREEN_WIDTH_PX / (double)SCREEN_HEIGHT_PX,
                  1.0f,
                  1024.0f);
@@ -114,11 +125,13 @@ run()
     float z;
     int y_move; /* -1=(-)axis movement, 0=no movement, +1=(+)axis movement */
     int x_move;
+    int z_move;
   } camera;
   camera.x = camera.y = 0.f;
   camera.z = 20.f;
-  camera.y_move = camera.x_move = 0;
+  camera.y_move = camera.x_move = camera.z_move = 0;
   float camera_delta_pos_m = 10.f * TICK_DELTA_S;
+  float view_half_width_m, view_half_height_m;
 
   init_isolines((struct point2d_t){1.f, 1.f});
 
@@ -141,7 +154,7 @@ run()
         switch(event.window.event)
         {
         case SDL_WINDOWEVENT_RESIZED:
-          gluPerspective(60.0f, 
+          gluPerspective(CAMERA_FOV_Y_DEG, 
                          (double)event.window.data1 / (double)event.window.data2,
                          1.0f,
                          1024.0f);
@@ -170,6 +183,32 @@ run()
         {
           camera.x_move = -1;
         }
+        else if(event.key.keysym.sym == SDLK_u)
+        {
+          camera.z_move = 1;
+        }
+        else if(event.key.keysym.sym == SDLK_o)
+        {
+          camera.z_move = -1;
+        }
+        else if(event.key.keysym.sym == SDLK_m)
+        {
+          /* cycle through the isolines extraction modes */
+          set_isolines_extraction_mode((get_isolines_extraction_mode() + 1) % 
+                                       ISOLINES_EXTRACTION_MODE_COUNT);
+        }
+        else if(event.key.keysym.sym == SDLK_f)
+        {
+          set_isolines_field_frozen(!is_isolines_field_frozen());
+        }
+        else if(event.key.keysym.sym == SDLK_LEFTBRACKET)
+        {
+          shift_isolines_thresholds(-THRESHOLD_SHIFT_DELTA);
+        }
+        else if(event.key.keysym.sym == SDLK_RIGHTBRACKET)
+        {
+          shift_isolines_thresholds(THRESHOLD_SHIFT_DELTA);
+        }
         break;
       case SDL_KEYUP:
         if(event.key.repeat != 0)
@@ -192,6 +231,10 @@ run()
         {
           camera.x_move = 0;
         }
+        else if(event.key.keysym.sym == SDLK_u || event.key.keysym.sym == SDLK_o)
+        {
+          camera.z_move = 0;
+        }
         break;
       }
     }
@@ -202,7 +245,20 @@ run()
     {
       camera.x += camera.x_move * camera_delta_pos_m;
       camera.y += camera.y_move * camera_delta_pos_m;
-
+      camera.z += camera.z_move * camera_delta_pos_m * (camera.z / 10.f);
+      camera.z = fminf(fmaxf(camera.z, CAMERA_MIN_Z_M), CAMERA_MAX_Z_M);
+
+      /* the grid lies in the plane z = 0, perpendicular to the view, so the part of it in view 
+       * is a rectangle (centred as the focus below) and every cell is projected at the same size */
+      view_half_height_m = camera.z * tanf(CAMERA_FOV_Y_DEG * M_PI / 360.0);
+      view_half_width_m = view_half_height_m * SCREEN_WIDTH_PX / SCREEN_HEIGHT_PX;
+      set_isolines_pixel_size(2.f * view_half_height_m / SCREEN_HEIGHT_PX);
+      set_isolines_view_rect(
+        (struct point2d_t){-camera.x - view_half_width_m, camera.y - view_half_height_m},
+        (struct point2d_t){-camera.x + view_half_width_m, camera.y + view_half_height_m});
+
+      /* the view matrix translates the world by (x, -y) so the view is centred on (-x, y) */
+      set_isolines_focus((struct point2d_t){-camera.x, camera.y});
       tick_isolines();
 
       next_tick_s += TICK_DELTA_S;
@@ -0,0 +1,116 @@
+#include <assert.h>
+#include "pool.h"
+
+/* takes jobs from the current batch until there are none left */
+static void
+run_jobs(struct pool *p, int thread_id)
+{
+  int job_id;
+
+  while((job_id = __atomic_fetch_add(&p->next_job, 1, __ATOMIC_RELAXED)) < p->job_count)
+    p->job_fn(p->job_args, job_id, thread_id);
+}
+
+static void *
+worker_main(void *args)
+{
+  struct pool *p = ((struct pool_worker *)args)->p;
+  int thread_id = ((struct pool_worker *)args)->thread_id;
+  unsigned batch_id = 0;
+
+  pthread_mutex_lock(&p->mutex);
+  while(true)
+  {
+    while(!p->is_quitting && p->batch_id == batch_id)
+      pthread_cond_wait(&p->batch_cond, &p->mutex);
+
+    if(p->is_quitting)
+      break;
+
+    batch_id = p->batch_id;
+    pthread_mutex_unlock(&p->mutex);
+
+    run_jobs(p, thread_id);
+
+    pthread_mutex_lock(&p->mutex);
+    if(--p->busy_worker_count == 0)
+      pthread_cond_signal(&p->done_cond);
+  }
+  pthread_mutex_unlock(&p->mutex);
+
+  return NULL;
+}
+
+void
+pool_init(struct pool *p, int thread_count)
+{
+  int r;
+
+  assert(1 <= thread_count && thread_count <= POOL_MAX_THREAD_COUNT);
+
+  p->thread_count = thread_count;
+  p->job_count = p->next_job = 0;
+  p->batch_id = 0;
+  p->busy_worker_count = 0;
+  p->is_quitting = false;
+
+  r = pthread_mutex_init(&p->mutex, NULL);
+  assert(!r);
+  r = pthread_cond_init(&p->batch_cond, NULL);
+  assert(!r);
+  r = pthread_cond_init(&p->done_cond, NULL);
+  assert(!r);
+
+  for(int i = 0; i < thread_count - 1; i++)
+  {
+    p->workers[i].p = p;
+    p->workers[i].thread_id = i + 1;
+    r = pthread_create(&p->workers[i].thread, NULL, worker_main, &p->workers[i]);
+    assert(!r);
+  }
+  (void)r;
+}
+
+void
+pool_run(struct pool *p, pool_job_fn job_fn, void *job_args, int job_count)
+{
+  if(p->thread_count == 1)
+  {
+    for(int i = 0; i < job_count; i++)
+      job_fn(job_args, i, 0);
+    return;
+  }
+
+  pthread_mutex_lock(&p->mutex);
+  p->job_fn = job_fn;
+  p->job_args = job_args;
+  p->job_count = job_count;
+  p->next_job = 0;
+  p->busy_worker_count = p->thread_count - 1;
+  ++p->batch_id;
+  pthread_cond_broadcast(&p->batch_cond);
+  pthread_mutex_unlock(&p->mutex);
+
+  run_jobs(p, 0);
+
+  pthread_mutex_lock(&p->mutex);
+  while(p->busy_worker_count > 0)
+    pthread_cond_wait(&p->done_cond, &p->mutex);
+  pthread_mutex_unlock(&p->mutex);
+}
+
+void
+pool_destroy(struct pool *p)
+{
+  pthread_mutex_lock(&p->mutex);
+  p->is_quitting = true;
+  pthread_cond_broadcast(&p->batch_cond);
+  pthread_mutex_unlock(&p->mutex);
+
+  for(int i = 0; i < p->thread_count - 1; i++)
+    pthread_join(p->workers[i].thread, NULL);
+
+  pthread_mutex_destroy(&p->mutex);
+  pthread_cond_destroy(&p->batch_cond);
+  pthread_cond_destroy(&p->done_cond);
+}
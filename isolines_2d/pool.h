@@ -0,0 +1,71 @@
+#ifndef _POOL_H_
+#define _POOL_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+
+/* the maximum number of threads in a pool, including the thread which runs the jobs */
+#define POOL_MAX_THREAD_COUNT 16
+
+/**
+ * a job function; called once for every job of a batch. The job_id is the index of the job in
+ * the batch and the thread_id is the index of the pool thread running the job, in the range 
+ * [0, thread_count). The thread_id can be used to index per-thread scratch data; no two jobs
+ * with the same thread_id will ever run at the same time.
+ */
+typedef void (*pool_job_fn)(void *args, int job_id, int thread_id);
+
+/**
+ * a pool of worker threads which run batches of jobs. The thread which runs a batch also works on
+ * the batch (as thread 0), so a pool of N threads has N-1 worker threads.
+ *
+ * jobs are handed out in order of job_id; each thread takes the next job as soon as it finishes 
+ * its last, so uneven jobs are balanced between the threads.
+ */
+struct pool
+{
+  struct pool_worker
+  {
+    pthread_t thread;
+    struct pool *p;
+    int thread_id;
+  } workers[POOL_MAX_THREAD_COUNT - 1];
+  int thread_count;
+
+  pthread_mutex_t mutex;
+  pthread_cond_t batch_cond;  /* signalled when a batch is posted or the pool is destroyed */
+  pthread_cond_t done_cond;   /* signalled when the last worker leaves a batch */
+
+  /* the current batch */
+  pool_job_fn job_fn;
+  void *job_args;
+  int job_count;
+  int next_job;               /* accessed atomically */
+  unsigned batch_id;          /* incremented for each batch so workers know a batch is new */
+  int busy_worker_count;      /* workers still working on the current batch */
+
+  bool is_quitting;
+};
+
+/**
+ * pool_init - starts the worker threads of the pool; thread_count must be in the range 
+ *   [1, POOL_MAX_THREAD_COUNT].
+ */
+void
+pool_init(struct pool *p, int thread_count);
+
+/**
+ * pool_run - runs a batch of job_count jobs and returns once every job is complete. 
+ *
+ * note - batches can not be nested; a job function must not call pool_run on its own pool.
+ */
+void
+pool_run(struct pool *p, pool_job_fn job_fn, void *job_args, int job_count);
+
+/**
+ * pool_destroy - stops and joins the worker threads.
+ */
+void
+pool_destroy(struct pool *p);
+
+#endif
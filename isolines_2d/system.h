@@ -19,4 +19,36 @@ xmalloc(size_t size)
   return mem;
 }
 
+static inline void *
+xrealloc(void *mem, size_t size)
+{
+  mem = realloc(mem, size);
+  if(UNLIKELY(mem == 0))
+  {
+    fprintf(stderr, "fatal: out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+  return mem;
+}
+
+/* grows a buffer of elements, if needed, so it can hold at least 'count' elements. The capacity 
+ * at least doubles when the buffer grows so repeated growth is amortised. The buffer never 
+ * shrinks; it keeps its high water mark. */
+static inline void *
+xreserve(void *mem, int *capacity, int count, size_t element_size)
+{
+  int new_capacity;
+
+  if(LIKELY(count <= *capacity))
+    return mem;
+
+  new_capacity = (*capacity > 0) ? *capacity * 2 : 64;
+  if(new_capacity < count)
+    new_capacity = count;
+
+  mem = xrealloc(mem, element_size * new_capacity);
+  *capacity = new_capacity;
+  return mem;
+}
+
 #endif